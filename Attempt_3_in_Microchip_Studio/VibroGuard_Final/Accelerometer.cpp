@@ -24,44 +24,57 @@
 
 #include "Accelerometer.h"
 #include "auxiliary_functions.h"
-#include "I2C.h"
+#include "sensor_bus.h"
 
 // MPU6050 registers
 #define MPU6050_REG_RESET 0x6B
 #define MPU6050_REG_ACCEL_XOUT_H 0x3B
+#define MPU6050_REG_SMPLRT_DIV 0x19
+#define MPU6050_REG_CONFIG 0x1A
+#define MPU6050_REG_ACCEL_CONFIG 0x1C
+#define MPU6050_REG_FIFO_EN 0x23
 
-// Function to initialize the I2C connection and MPU6050
-void Accelerometer::begin(int device_address)
+// Function to initialize the sensor bus and MPU6050
+void Accelerometer::begin(SensorBus &sensorBus)
 {
-    i2c_address = device_address; // Set the device address for I2C communication
+    bus = &sensorBus;
+    range = ACC_RANGE_2G; // The MPU6050 starts up in the ±2g range
+    requested = false;
 
-    I2c.timeOut(1000); // Set I2C timeout period to 1000ms, to automatically recover from lockups
+    bus->begin(); // Initialize the I2C or SPI communication
 
-    I2c.begin(); // Initialize the I2C communication
-    I2c.write(i2c_address, MPU6050_REG_RESET, 0x00); // Write 0x00 to the MPU6050_REG_RESET register to reset the MPU6050
-    I2c.end(); // End the I2C communication
+    const uint8_t wake = 0x00;
+    bus->write(MPU6050_REG_RESET, &wake, 1); // Write 0x00 to the MPU6050_REG_RESET register to reset the MPU6050
+
+    // Load the configuration registers into the shadow with a single read
+    if (bus->read(ACC_SHADOW_FIRST, shadow, ACC_SHADOW_SIZE))
+    {
+        memset(shadow, 0, ACC_SHADOW_SIZE); // Assume the power-on values, which are all zero
+    }
+    memcpy(staged, shadow, ACC_SHADOW_SIZE);
+    range = (shadow[MPU6050_REG_ACCEL_CONFIG - ACC_SHADOW_FIRST] >> 3) & 0x03;
 }
 
 // Function to read acceleration values from the MPU6050
 void Accelerometer::readAcceleration()
 {
-    int16_t rawAccX, rawAccY, rawAccZ; // Variables to store raw acceleration data
-
-    I2c.begin(); // Initialize the I2C communication
-    I2c.read(i2c_address, MPU6050_REG_ACCEL_XOUT_H, 6); // Read 6 bytes (x, y, z) from the MPU6050
+    waitForRequest(); // Do not let a background read overwrite the result
 
-    // Read raw acceleration data from the I2C buffer
-    rawAccX = (I2c.receive() << 8) | (I2c.receive());
-    rawAccY = (I2c.receive() << 8) | (I2c.receive());
-    rawAccZ = (I2c.receive() << 8) | (I2c.receive());
+    // Read 6 bytes (x, y, z) from the MPU6050 directly into the sample
+    if (bus->read(MPU6050_REG_ACCEL_XOUT_H, sample, sizeof(sample)))
+    {
+        memset(sample, 0, sizeof(sample)); // A failed read gives zero like before
+    }
 
-    I2c.end(); // End the I2C communication
+    convertAcceleration();
+}
 
-    // Convert raw data to g-force (for ±2g range)
-    const float accScale = 16384.0; // Scaling factor for accelerometer
-    accX = (float)rawAccX / accScale; // Convert raw X data to g-force
-    accY = (float)rawAccY / accScale; // Convert raw Y data to g-force
-    accZ = (float)rawAccZ / accScale; // Convert raw Z data to g-force
+// Function to convert the raw sample to signed readings
+void Accelerometer::convertAcceleration()
+{
+    accX = (sample[0] << 8) | sample[1];
+    accY = (sample[2] << 8) | sample[3];
+    accZ = (sample[4] << 8) | sample[5];
 }
 
 // Function to get acceleration values and map them to a 0-255 range
@@ -69,12 +82,156 @@ struct accComp Accelerometer::getAcceleration()
 {
     readAcceleration(); // Read the current acceleration values
 
+    return mapAcceleration();
+}
+
+// Function to start reading the acceleration in the background
+// Returns false if the previous read has not been collected yet or the bus is busy
+bool Accelerometer::requestAcceleration()
+{
+    if (requested)
+    {
+        return false;
+    }
+
+    requested = bus->request(MPU6050_REG_ACCEL_XOUT_H, sample, sizeof(sample));
+    return requested;
+}
+
+// Function to get the result of requestAcceleration() mapped to a 0-255 range
+// Returns false while the read is in progress or if it failed
+bool Accelerometer::collectAcceleration(struct accComp *readings)
+{
+    bus->poll(); // Time out a hung transfer
+
+    if (!requested || bus->status() == SENSOR_BUS_BUSY)
+    {
+        return false;
+    }
+    requested = false;
+
+    if (bus->status())
+    {
+        return false; // Keep the previous values
+    }
+
+    convertAcceleration();
+    *readings = mapAcceleration();
+    return true;
+}
+
+// Function to wait for and discard a background read
+void Accelerometer::waitForRequest()
+{
+    while (requested && bus->status() == SENSOR_BUS_BUSY)
+    {
+        bus->poll();
+    }
+    requested = false;
+}
+
+// Function to map the converted acceleration values to a 0-255 range
+struct accComp Accelerometer::mapAcceleration()
+{
     struct accComp readings; // Structure to store the mapped acceleration values
 
-    // Map accelerometer values to 0-255 range
-    readings.AccX = (uint8_t)map_range(accX * 100, -200, 200, 0, 255);
-    readings.AccY = (uint8_t)map_range(accY * 100, -200, 200, 0, 255);
-    readings.AccZ = (uint8_t)map_range(accZ * 100, -200, 200, 0, 255);
+    // Map accelerometer values over the full-scale range to 0-255 range. The
+    // full scale is always the whole 16-bit reading, whatever the range.
+    readings.AccX = map_range<-32768, 32768, 0, 255>(accX);
+    readings.AccY = map_range<-32768, 32768, 0, 255>(accY);
+    readings.AccZ = map_range<-32768, 32768, 0, 255>(accZ);
 
     return readings; // Return the mapped acceleration values
 }
+
+// Function to change several settings at once, in as few transfers as possible
+void Accelerometer::configure(const struct accConfig &config)
+{
+    stageRegister(MPU6050_REG_ACCEL_CONFIG, (config.range & 0x03) << 3); // AFS_SEL is bits 4:3 of ACCEL_CONFIG
+    stageRegister(MPU6050_REG_CONFIG, config.lowPassFilter & 0x07);
+    stageRegister(MPU6050_REG_SMPLRT_DIV, config.sampleRateDivider);
+    stageRegister(MPU6050_REG_FIFO_EN, config.fifoEnable);
+    commitConfiguration();
+}
+
+// Function to select the full-scale range of the MPU6050
+void Accelerometer::setRange(uint8_t accRange)
+{
+    stageRegister(MPU6050_REG_ACCEL_CONFIG, (accRange & 0x03) << 3); // AFS_SEL is bits 4:3 of ACCEL_CONFIG
+    commitConfiguration();
+}
+
+// Function to select the digital low-pass filter (one of the ACC_FILTER_* values)
+void Accelerometer::setLowPassFilter(uint8_t filter)
+{
+    stageRegister(MPU6050_REG_CONFIG, filter & 0x07);
+    commitConfiguration();
+}
+
+// Function to set the sample rate divider of the sensor output
+void Accelerometer::setSampleRateDivider(uint8_t divider)
+{
+    stageRegister(MPU6050_REG_SMPLRT_DIV, divider);
+    commitConfiguration();
+}
+
+// Function to get the selected low-pass filter
+uint8_t Accelerometer::getLowPassFilter()
+{
+    return staged[MPU6050_REG_CONFIG - ACC_SHADOW_FIRST] & 0x07;
+}
+
+// Function to set a configuration register for the next commit
+void Accelerometer::stageRegister(uint8_t reg, uint8_t value)
+{
+    staged[reg - ACC_SHADOW_FIRST] = value;
+}
+
+// Function to write the staged registers that differ from the sensor
+//
+// Runs of adjacent changed registers go out as one burst write, unchanged
+// registers are not written at all. A failed write leaves the shadow as it was,
+// so the next commit tries again.
+void Accelerometer::commitConfiguration()
+{
+    uint8_t stagedRange = (staged[MPU6050_REG_ACCEL_CONFIG - ACC_SHADOW_FIRST] >> 3) & 0x03;
+    if (stagedRange != range)
+    {
+        waitForRequest(); // A background read would be converted with the new range
+    }
+
+    uint8_t i = 0;
+    while (i < ACC_SHADOW_SIZE)
+    {
+        if (staged[i] == shadow[i])
+        {
+            i++;
+            continue;
+        }
+
+        uint8_t first = i;
+        while (i < ACC_SHADOW_SIZE && staged[i] != shadow[i])
+        {
+            i++;
+        }
+
+        if (bus->write(ACC_SHADOW_FIRST + first, &staged[first], i - first) == 0)
+        {
+            memcpy(&shadow[first], &staged[first], i - first);
+        }
+    }
+
+    range = (shadow[MPU6050_REG_ACCEL_CONFIG - ACC_SHADOW_FIRST] >> 3) & 0x03;
+}
+
+// Function to get the selected full-scale range (one of the ACC_RANGE_* values)
+uint8_t Accelerometer::getRange()
+{
+    return range;
+}
+
+// Function to get the selected full-scale range in g
+int Accelerometer::getFullScale()
+{
+    return 2 << range;
+}
@@ -27,9 +27,37 @@
 #define ACCELEROMETER_H
 
 #include <stdint.h>
+#include "sensor_bus.h"
 
 using namespace std;
 
+// Accelerometer full-scale ranges (AFS_SEL field of ACCEL_CONFIG)
+#define ACC_RANGE_2G 0
+#define ACC_RANGE_4G 1
+#define ACC_RANGE_8G 2
+#define ACC_RANGE_16G 3
+
+// Digital low-pass filter settings (DLPF_CFG field of CONFIG), accelerometer bandwidth
+#define ACC_FILTER_260HZ 0
+#define ACC_FILTER_184HZ 1
+#define ACC_FILTER_94HZ 2
+#define ACC_FILTER_44HZ 3
+#define ACC_FILTER_21HZ 4
+#define ACC_FILTER_10HZ 5
+#define ACC_FILTER_5HZ 6
+
+// Configuration registers mirrored in RAM, SMPLRT_DIV (0x19) to FIFO_EN (0x23)
+#define ACC_SHADOW_FIRST 0x19
+#define ACC_SHADOW_SIZE 11
+
+struct accConfig
+{
+  uint8_t range;             // ACC_RANGE_*
+  uint8_t lowPassFilter;     // ACC_FILTER_*
+  uint8_t sampleRateDivider; // Sensor output rate is 1 kHz / (1 + divider) with the filter on
+  uint8_t fifoEnable;        // FIFO_EN register value
+};
+
 struct accComp
 {
   uint8_t AccX;
@@ -40,14 +68,35 @@ struct accComp
 class Accelerometer
 {
 private:
-  int i2c_address;
-  float accX, accY, accZ;
+  SensorBus *bus; // I2C or SPI, the register map is the same
+  uint8_t range;
+  int16_t accX, accY, accZ; // Raw readings, 16384 LSB/g at ±2g and halved for each larger range
+
+  uint8_t shadow[ACC_SHADOW_SIZE]; // Configuration registers as written to the sensor
+  uint8_t staged[ACC_SHADOW_SIZE]; // Configuration registers after the next commit
+
+  uint8_t sample[6]; // ACCEL_XOUT_H to ACCEL_ZOUT_L as read from the sensor
+  bool requested;    // A read started by requestAcceleration() has not been collected
 
   void readAcceleration();
+  void convertAcceleration();
+  struct accComp mapAcceleration();
+  void waitForRequest();
+  void stageRegister(uint8_t reg, uint8_t value);
+  void commitConfiguration();
 
 public:
-  void begin(int device_address);
+  void begin(SensorBus &sensorBus);
   struct accComp getAcceleration();
+  bool requestAcceleration();
+  bool collectAcceleration(struct accComp *readings);
+  void configure(const struct accConfig &config);
+  void setRange(uint8_t accRange);
+  void setLowPassFilter(uint8_t filter);
+  void setSampleRateDivider(uint8_t divider);
+  uint8_t getRange();
+  uint8_t getLowPassFilter();
+  int getFullScale();
 };
 
 #endif
\ No newline at end of file
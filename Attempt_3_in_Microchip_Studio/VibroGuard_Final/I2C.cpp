@@ -22,43 +22,53 @@
 */
 
 #include <inttypes.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
 #include "I2C.h"
 #include "auxiliary_functions.h"
+#include "board.h"
+
+// TWCR value that lets the TWI perform the next step with its interrupt enabled
+#define TWI_CONTINUE (_BV(TWINT) | _BV(TWEN) | _BV(TWIE))
 
 uint8_t I2C::bytesAvailable = 0;
 uint8_t I2C::bufferIndex = 0;
 uint8_t I2C::totalBytes = 0;
 uint16_t I2C::timeOutDelay = 0;
 
-I2C::I2C()
+I2C::I2C() : queueHead(0), queueTail(0), transactionsStarted(0), position(0), stage(0), activeSince(0), activeLimit(0), speed(0), byteTicks(0), consecutiveErrors(0), statsCount(0), recoveries(0)
 {
+#if I2C_TRACE_SIZE
+  traceEnd = 0;
+  traceFilled = 0;
+  traceHeld = false;
+#endif
 }
 
 ////////////// Public Methods ////////////////////////////////////////
 
 /*
  *  Description:
- *      Enables the I2C hardware
+ *      Returns the SCL frequency, which is lower than the one requested if the
+ *      driver had to fall back after repeated errors
  *  Parameters:
  *      none
  *  Returns:
- *      none
+ *      uint32_t
+ *          SCL frequency in Hz
  */
-void I2C::begin()
+uint32_t I2C::getSpeed()
 {
-  pullup(1);
-
-  // initialize twi prescaler and bit rate
-  cbi(TWSR, TWPS0);
-  cbi(TWSR, TWPS1);
-  TWBR = ((F_CPU / 100000) - 16) / 2;
-  // enable twi module and acks
-  TWCR = _BV(TWEN) | _BV(TWEA);
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t frequency = speed;
+  SREG = sreg;
+  return (frequency);
 }
 
 /*
  *  Description:
- *      Disables the I2C hardware
+ *      Disables the I2C hardware once all queued transactions have completed
  *  Parameters:
  *      none
  *  Returns:
@@ -66,6 +76,10 @@ void I2C::begin()
  */
 void I2C::end()
 {
+  while (!idle())
+  {
+    poll();
+  }
   TWCR = 0;
 }
 
@@ -76,18 +90,22 @@ void I2C::end()
  *      which typically requires a power cycle to restart your program. This
  *      allows the user to define a time out in which the I2C will release
  *      itself and reinitialize and continue on with the next function. Setting
- *      the value to zero will disable the function. On a side note, be careful
- *      with setting too low a value because some devices support clock
- *      stretching which can increase the time before an acknowledgment is sent
- *      which could be misconstrued as a lockup.
+ *      the value to zero will disable the function.
+ *
+ *      The limit of every transfer is twice the time its bytes take at the
+ *      current bus speed plus this allowance, so a glitch costs well under a
+ *      millisecond instead of a fixed delay. Devices that stretch the clock
+ *      need a larger allowance, or stretching could be misconstrued as a
+ *      lockup. Limits are measured with ticks_elapsed() and capped at
+ *      I2C_TIMEOUT_MAX_TICKS.
  *
  *      If a lock up occurs the returned parameters from Read and/or Writes will
  *      contain a 1.
  *
  *  Parameters:
  *      timeOut - uint16_t
- *          The amount of time to wait before timing out. Can range from
- *          0 - 65535 milliseconds. If it's set to 0 it will be disabled.
+ *          The allowance on top of the transfer time. Can range from
+ *          0 - 65535 microseconds. If it's set to 0 it will be disabled.
  *  Returns:
  *      none
  */
@@ -110,41 +128,15 @@ void I2C::pullup(uint8_t activate)
 {
   if (activate)
   {
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328PB__)
-    // activate internal pull-ups for twi
-    // as per note from atmega8 manual pg167
-    sbi(PORTC, 4);
-    sbi(PORTC, 5);
-#elif defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__)
     // activate internal pull-ups for twi
-    // as per note from atmega644p manual pg108
-    sbi(PORTC, 0);
-    sbi(PORTC, 1);
-#else
-    // activate internal pull-ups for twi
-    // as per note from atmega128 manual pg204
-    sbi(PORTD, 0);
-    sbi(PORTD, 1);
-#endif
+    Board::Sda::high();
+    Board::Scl::high();
   }
   else
   {
-#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328PB__)
-    // deactivate internal pull-ups for twi
-    // as per note from atmega8 manual pg167
-    cbi(PORTC, 4);
-    cbi(PORTC, 5);
-#elif defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__)
     // deactivate internal pull-ups for twi
-    // as per note from atmega644p manual pg108
-    cbi(PORTC, 0);
-    cbi(PORTC, 1);
-#else
-    // deactivate internal pull-ups for twi
-    // as per note from atmega128 manual pg204
-    cbi(PORTD, 0);
-    cbi(PORTD, 1);
-#endif
+    Board::Sda::low();
+    Board::Scl::low();
   }
 }
 
@@ -190,48 +182,47 @@ uint8_t I2C::receive()
  */
 uint8_t I2C::write(uint8_t address, uint8_t registerAddress, uint8_t data)
 {
-  returnStatus = 0;
-  returnStatus = _start();
-  if (returnStatus)
-  {
-    return (returnStatus);
-  }
-  returnStatus = _sendAddress(SLA_W(address));
-  if (returnStatus)
-  {
-    if (returnStatus == 1)
-    {
-      return (2);
-    }
-    return (returnStatus);
-  }
-  returnStatus = _sendByte(registerAddress);
-  if (returnStatus)
-  {
-    if (returnStatus == 1)
-    {
-      return (3);
-    }
-    return (returnStatus);
-  }
-  returnStatus = _sendByte(data);
-  if (returnStatus)
-  {
-    if (returnStatus == 1)
-    {
-      return (3);
-    }
-    return (returnStatus);
-  }
-  returnStatus = _stop();
-  if (returnStatus)
-  {
-    if (returnStatus == 1)
-    {
-      return (7);
-    }
-    return (returnStatus);
-  }
+  I2CTransaction transaction;
+  transaction.address = address;
+  transaction.registerAddress = registerAddress;
+  transaction.direction = I2C_WRITE;
+  transaction.length = 1;
+  transaction.buffer = &data;
+  transaction.callback = NULL;
+
+  returnStatus = transfer(&transaction);
+  return (returnStatus);
+}
+
+/*
+ *  Description:
+ *      Writes numberBytes bytes to consecutive registers starting at
+ *      registerAddress in a single transaction, for devices that increment
+ *      their register pointer after every byte.
+ *  Parameters:
+ *      address - uint8_t
+ *          The 7 bit I2C slave address
+ *      registerAddress - uint8_t
+ *          Address of the first register to write
+ *      source - const uint8_t *
+ *          The bytes to send
+ *      numberBytes - uint16_t
+ *          The number of bytes to send
+ *  Returns:
+ *      uint8_t
+ *          0 on success, otherwise the same error codes as the other write()
+ */
+uint8_t I2C::write(uint8_t address, uint8_t registerAddress, const uint8_t *source, uint16_t numberBytes)
+{
+  I2CTransaction transaction;
+  transaction.address = address;
+  transaction.registerAddress = registerAddress;
+  transaction.direction = I2C_WRITE;
+  transaction.length = numberBytes;
+  transaction.buffer = (uint8_t *)source; // Only read for writes
+  transaction.callback = NULL;
+
+  returnStatus = transfer(&transaction);
   return (returnStatus);
 }
 
@@ -263,7 +254,6 @@ uint8_t I2C::read(uint8_t address, uint8_t registerAddress, uint8_t numberBytes)
 {
   bytesAvailable = 0;
   bufferIndex = 0;
-  numberBytes = numberBytes;
   if (numberBytes > MAX_BUFFER_SIZE)
   {
     numberBytes = MAX_BUFFER_SIZE;
@@ -272,91 +262,450 @@ uint8_t I2C::read(uint8_t address, uint8_t registerAddress, uint8_t numberBytes)
   {
     numberBytes++;
   }
-  nack = numberBytes - 1;
-  returnStatus = 0;
-  returnStatus = _start();
-  if (returnStatus)
+
+  I2CTransaction transaction;
+  transaction.address = address;
+  transaction.registerAddress = registerAddress;
+  transaction.direction = I2C_READ;
+  transaction.length = numberBytes;
+  transaction.buffer = data;
+  transaction.callback = NULL;
+
+  returnStatus = transfer(&transaction);
+  if (!returnStatus)
   {
-    return (returnStatus);
+    bytesAvailable = numberBytes;
+    totalBytes = numberBytes;
   }
-  returnStatus = _sendAddress(SLA_W(address));
-  if (returnStatus)
+  return (returnStatus);
+}
+
+/*
+ *  Description:
+ *      Reads numberBytes bytes starting at registerAddress straight into the
+ *      caller's buffer. Unlike read(address, registerAddress, numberBytes)
+ *      there is no size limit and no copy through the internal buffer, so
+ *      this suits long transfers such as draining a sensor FIFO.
+ *  Parameters:
+ *      address - uint8_t
+ *          The 7 bit I2C slave address
+ *      registerAddress - uint8_t
+ *          Starting register address to read data from
+ *      destination - uint8_t *
+ *          Buffer of at least numberBytes bytes
+ *      numberBytes - uint16_t
+ *          The number of bytes to be read
+ *  Returns:
+ *      uint8_t
+ *          0 on success, otherwise the same error codes as the other read()
+ */
+uint8_t I2C::read(uint8_t address, uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes)
+{
+  if (numberBytes == 0)
   {
-    if (returnStatus == 1)
-    {
-      return (2);
-    }
-    return (returnStatus);
+    return (0);
+  }
+
+  I2CTransaction transaction;
+  transaction.address = address;
+  transaction.registerAddress = registerAddress;
+  transaction.direction = I2C_READ;
+  transaction.length = numberBytes;
+  transaction.buffer = destination;
+  transaction.callback = NULL;
+
+  returnStatus = transfer(&transaction);
+  return (returnStatus);
+}
+
+//////////// INTERRUPT-DRIVEN TRANSFERS
+
+/*
+ *  Description:
+ *      Queues a transaction and returns immediately. The transfer runs from
+ *      the TWI interrupt, one transaction after the other, while the caller
+ *      keeps working. May also be called from a completion callback.
+ *  Parameters:
+ *      transaction - I2CTransaction *
+ *          Transfer to perform, must stay valid until it has completed
+ *  Returns:
+ *      bool
+ *          true: The transaction was queued
+ *          false: The queue is full, try again later
+ */
+bool I2C::submit(I2CTransaction *transaction)
+{
+  uint8_t sreg = SREG; // Keep interrupts disabled when called from a callback
+  cli();
+
+  if ((uint8_t)(queueHead - queueTail) == I2C_QUEUE_SIZE)
+  {
+    SREG = sreg;
+    return (false);
   }
-  returnStatus = _sendByte(registerAddress);
-  if (returnStatus)
+
+  transaction->status = I2C_STATUS_BUSY;
+  queue[queueHead & (I2C_QUEUE_SIZE - 1)] = transaction;
+  queueHead++;
+
+  // Start right away if the bus was idle
+  if ((uint8_t)(queueHead - queueTail) == 1)
   {
-    if (returnStatus == 1)
-    {
-      return (3);
-    }
-    return (returnStatus);
+    start();
   }
-  returnStatus = _start();
-  if (returnStatus)
+
+  SREG = sreg;
+  return (true);
+}
+
+/*
+ *  Description:
+ *      Queues a transaction and waits until it has completed. Interrupts must
+ *      be enabled.
+ *  Parameters:
+ *      transaction - I2CTransaction *
+ *          Transfer to perform
+ *  Returns:
+ *      uint8_t
+ *          0: The transaction was successful
+ *          1 - 7: The transaction timed out, the value tells at which step
+ *          0x08 - 0xF8: TWI status of the failed step (see the datasheet)
+ *          0xFE: Bus error
+ */
+uint8_t I2C::transfer(I2CTransaction *transaction)
+{
+  while (!submit(transaction))
   {
-    if (returnStatus == 1)
-    {
-      return (4);
-    }
-    return (returnStatus);
+    poll(); // Wait for a free queue slot
   }
-  returnStatus = _sendAddress(SLA_R(address));
-  if (returnStatus)
+  while (transaction->status == I2C_STATUS_BUSY)
   {
-    if (returnStatus == 1)
-    {
-      return (5);
-    }
-    return (returnStatus);
+    poll();
+  }
+  return (transaction->status);
+}
+
+/*
+ *  Description:
+ *      Aborts the active transaction once it has been running for longer than
+ *      the time out, so a hung bus cannot stall the queue. Call regularly when
+ *      using submit().
+ *  Parameters:
+ *      none
+ *  Returns:
+ *      none
+ */
+void I2C::poll()
+{
+  if (idle() || !timeOutDelay)
+  {
+    return;
+  }
+
+  // activeSince and activeLimit change in the interrupt, a torn read can only
+  // cause a false alarm, which is checked again with interrupts disabled
+  uint8_t started = transactionsStarted;
+  if (ticks_since(activeSince) < activeLimit)
+  {
+    return;
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  // It may have completed in the meantime
+  if (idle() || transactionsStarted != started || ticks_since(activeSince) < activeLimit)
+  {
+    SREG = sreg;
+    return;
+  }
+
+  // Stop the interrupt from advancing the transaction. It stays at the head of
+  // the queue during the recovery, so submit() queues behind it and idle()
+  // stays false.
+  TWCR = 0;
+  uint8_t address = queue[queueTail & (I2C_QUEUE_SIZE - 1)]->address;
+  countError(address, 1);
+  SREG = sreg;
+
+  // A slave that lost track of the transfer may be holding SDA low. The
+  // recovery takes about 100 µs, other interrupts keep running meanwhile.
+  bool recovered = recover();
+
+  cli();
+  if (recovered)
+  {
+    countError(address, 0);
   }
-  for (uint8_t i = 0; i < numberBytes; i++)
+  finish(stage);
+  SREG = sreg;
+}
+
+/*
+ *  Description:
+ *      Checks whether all queued transactions have completed
+ *  Parameters:
+ *      none
+ *  Returns:
+ *      bool
+ *          true: No transaction is queued or in progress
+ */
+bool I2C::idle()
+{
+  return (queueHead == queueTail);
+}
+
+/*
+ *  Description:
+ *      Advances the active transaction by one bus operation. Called from
+ *      TWI_vect only.
+ *  Parameters:
+ *      none
+ *  Returns:
+ *      none
+ */
+void I2C::interrupt()
+{
+  I2CTransaction *transaction = queue[queueTail & (I2C_QUEUE_SIZE - 1)];
+
+  switch (TWI_STATUS)
   {
-    if (i == nack)
+  case START:
+    stage = 2;
+    TWDR = SLA_W(transaction->address);
+    TWCR = TWI_CONTINUE;
+    break;
+
+  case MT_SLA_ACK:
+    stage = 3;
+    TWDR = transaction->registerAddress;
+    TWCR = TWI_CONTINUE;
+    break;
+
+  case MT_DATA_ACK:
+    if (transaction->direction == I2C_READ)
     {
-      returnStatus = _receiveByte(0);
-      if (returnStatus == 1)
-      {
-        return (6);
-      }
-      if (returnStatus != MR_DATA_NACK)
-      {
-        return (returnStatus);
-      }
+      // The register address is set, switch to receiving
+      stage = 4;
+      TWCR = TWI_CONTINUE | _BV(TWSTA);
+    }
+    else if (position < transaction->length)
+    {
+      TWDR = transaction->buffer[position++];
+      TWCR = TWI_CONTINUE;
     }
     else
     {
-      returnStatus = _receiveByte(1);
-      if (returnStatus == 1)
-      {
-        return (6);
-      }
-      if (returnStatus != MR_DATA_ACK)
-      {
-        return (returnStatus);
-      }
+      finish(0);
     }
-    data[i] = TWDR;
-    bytesAvailable = i + 1;
-    totalBytes = i + 1;
+    break;
+
+  case REPEATED_START:
+    stage = 5;
+    TWDR = SLA_R(transaction->address);
+    TWCR = TWI_CONTINUE;
+    break;
+
+  case MR_SLA_ACK:
+    stage = 6;
+    // Acknowledge every byte but the last one
+    TWCR = (transaction->length > 1) ? (TWI_CONTINUE | _BV(TWEA)) : TWI_CONTINUE;
+    break;
+
+  case MR_DATA_ACK:
+    transaction->buffer[position++] = TWDR;
+    TWCR = (position + 1 < transaction->length) ? (TWI_CONTINUE | _BV(TWEA)) : TWI_CONTINUE;
+    break;
+
+  case MR_DATA_NACK:
+    transaction->buffer[position++] = TWDR;
+    finish(0);
+    break;
+
+  case MT_SLA_NACK:
+  case MT_DATA_NACK:
+  case MR_SLA_NACK:
+    finish(TWI_STATUS);
+    break;
+
+  default:
+  {
+    // Lost arbitration or bus error
+    uint8_t bufferedStatus = TWI_STATUS;
+    lockUp();
+    finish(bufferedStatus ? bufferedStatus : I2C_STATUS_BUS_ERROR);
+    break;
+  }
+  }
+}
+
+/*
+ *  Description:
+ *      Frees the bus when a slave holds SDA low, typically after the master
+ *      was reset or timed out in the middle of a byte. The TWI is released,
+ *      SCL is clocked by hand until the slave lets go of SDA (at most nine
+ *      pulses, enough to finish any byte and its acknowledge), then a STOP is
+ *      generated and the TWI is enabled again. Takes about 100 µs.
+ *  Parameters:
+ *      none
+ *  Returns:
+ *      bool
+ *          true: SDA was held low and has been released
+ *          false: SDA was not held low, or is still held after nine pulses
+ */
+bool I2C::recover()
+{
+  TWCR = 0; // Hand the pins back to the port
+
+  Board::Sda::release();
+  Board::Scl::release();
+  _delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+  if (Board::Sda::read())
+  {
+    enable();
+    return (false);
   }
-  returnStatus = _stop();
-  if (returnStatus)
+
+  for (uint8_t pulse = 0; pulse < 9 && !Board::Sda::read(); pulse++)
   {
-    if (returnStatus == 1)
-    {
-      return (7);
-    }
-    return (returnStatus);
+    Board::Scl::pullLow();
+    _delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+    Board::Scl::release();
+    _delay_us(I2C_RECOVERY_HALF_PERIOD_US);
   }
-  return (returnStatus);
+
+  // STOP: SDA rises while SCL is high
+  Board::Scl::pullLow();
+  Board::Sda::pullLow();
+  _delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+  Board::Scl::release();
+  _delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+  Board::Sda::release();
+  _delay_us(I2C_RECOVERY_HALF_PERIOD_US);
+
+  bool released = Board::Sda::read();
+  if (released)
+  {
+    recoveries++;
+  }
+
+  enable();
+  return (released);
+}
+
+/*
+ *  Description:
+ *      Copies the error counters of a slave address
+ *  Parameters:
+ *      index - uint8_t
+ *          0 to I2C_STATS_DEVICES - 1, in the order the addresses were first
+ *          used
+ *      target - I2CDeviceStats *
+ *          Receives the counters
+ *  Returns:
+ *      bool
+ *          false: No address has been recorded at this index
+ */
+bool I2C::getStats(uint8_t index, I2CDeviceStats *target)
+{
+  if (index >= statsCount)
+  {
+    return (false);
+  }
+
+  uint8_t sreg = SREG;
+  cli();
+  *target = stats[index];
+  SREG = sreg;
+  return (true);
+}
+
+/*
+ *  Description:
+ *      Returns the number of times recover() freed the bus
+ *  Parameters:
+ *      none
+ *  Returns:
+ *      uint16_t
+ *          Successful recoveries since start-up
+ */
+uint16_t I2C::getRecoveries()
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t count = recoveries;
+  SREG = sreg;
+  return (count);
+}
+
+#if I2C_TRACE_SIZE
+/*
+ *  Description:
+ *      Stops or resumes recording transactions, so that the trace can be read
+ *      out over a slow link without being overwritten. Only available when
+ *      I2C_TRACE_SIZE is not 0.
+ *  Parameters:
+ *      hold - bool
+ *          true: Stop recording, false: resume
+ *  Returns:
+ *      none
+ */
+void I2C::holdTrace(bool hold)
+{
+  traceHeld = hold;
 }
 
+/*
+ *  Description:
+ *      Returns the number of transactions the trace has recorded, to be used
+ *      with getTrace(). Only available when I2C_TRACE_SIZE is not 0.
+ *  Parameters:
+ *      none
+ *  Returns:
+ *      uint16_t
+ *          Recorded transactions since start-up, modulo 65536
+ */
+uint16_t I2C::getTraceEnd()
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t end = traceEnd;
+  SREG = sreg;
+  return (end);
+}
+
+/*
+ *  Description:
+ *      Copies a recorded transaction out of the trace. Entries are numbered
+ *      in completion order and the last I2C_TRACE_SIZE of them are kept, so
+ *      with the trace held, getTraceEnd() - I2C_TRACE_SIZE up to
+ *      getTraceEnd() - 1 are the entries to read.
+ *  Parameters:
+ *      number - uint16_t
+ *          Number of the transaction, counted from start-up modulo 65536
+ *      target - I2CTraceEntry *
+ *          Receives the entry
+ *  Returns:
+ *      bool
+ *          false: The transaction has been overwritten or not happened yet
+ */
+bool I2C::getTrace(uint16_t number, I2CTraceEntry *target)
+{
+  bool found = false;
+
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t age = traceEnd - number; // 1 for the most recent transaction
+  if (age >= 1 && age <= traceFilled)
+  {
+    *target = traceRing[number & (I2C_TRACE_SIZE - 1)];
+    found = true;
+  }
+  SREG = sreg;
+  return (found);
+}
+#endif
+
 //////////// LOW-LEVEL METHODS
 //////////// (No need to use them if the device uses normal register protocol)
 
@@ -375,15 +724,11 @@ uint8_t I2C::read(uint8_t address, uint8_t registerAddress, uint8_t numberBytes)
  */
 uint8_t I2C::_start()
 {
-  unsigned long startingTime = millis_elapsed();
+  uint16_t startingTime = ticks_elapsed();
   TWCR = (1 << TWINT) | (1 << TWSTA) | (1 << TWEN);
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOutDelay)
-    {
-      continue;
-    }
-    if ((millis_elapsed() - startingTime) >= timeOutDelay)
+    if (timedOut(startingTime))
     {
       lockUp();
       return (1);
@@ -420,15 +765,11 @@ uint8_t I2C::_start()
 uint8_t I2C::_sendAddress(uint8_t i2cAddress)
 {
   TWDR = i2cAddress;
-  unsigned long startingTime = millis_elapsed();
+  uint16_t startingTime = ticks_elapsed();
   TWCR = (1 << TWINT) | (1 << TWEN);
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOutDelay)
-    {
-      continue;
-    }
-    if ((millis_elapsed() - startingTime) >= timeOutDelay)
+    if (timedOut(startingTime))
     {
       lockUp();
       return (1);
@@ -466,15 +807,11 @@ uint8_t I2C::_sendAddress(uint8_t i2cAddress)
 uint8_t I2C::_sendByte(uint8_t i2cData)
 {
   TWDR = i2cData;
-  unsigned long startingTime = millis_elapsed();
+  uint16_t startingTime = ticks_elapsed();
   TWCR = (1 << TWINT) | (1 << TWEN);
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOutDelay)
-    {
-      continue;
-    }
-    if ((millis_elapsed() - startingTime) >= timeOutDelay)
+    if (timedOut(startingTime))
     {
       lockUp();
       return (1);
@@ -518,7 +855,7 @@ uint8_t I2C::_sendByte(uint8_t i2cData)
  */
 uint8_t I2C::_receiveByte(uint8_t ack)
 {
-  unsigned long startingTime = millis_elapsed();
+  uint16_t startingTime = ticks_elapsed();
   if (ack)
   {
     TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWEA);
@@ -529,11 +866,7 @@ uint8_t I2C::_receiveByte(uint8_t ack)
   }
   while (!(TWCR & (1 << TWINT)))
   {
-    if (!timeOutDelay)
-    {
-      continue;
-    }
-    if ((millis_elapsed() - startingTime) >= timeOutDelay)
+    if (timedOut(startingTime))
     {
       lockUp();
       return (1);
@@ -610,15 +943,11 @@ uint8_t I2C::_receiveByte(uint8_t ack, uint8_t *target)
  */
 uint8_t I2C::_stop()
 {
-  unsigned long startingTime = millis_elapsed();
+  uint16_t startingTime = ticks_elapsed();
   TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
   while ((TWCR & (1 << TWSTO)))
   {
-    if (!timeOutDelay)
-    {
-      continue;
-    }
-    if ((millis_elapsed() - startingTime) >= timeOutDelay)
+    if (timedOut(startingTime))
     {
       lockUp();
       return (1);
@@ -629,10 +958,218 @@ uint8_t I2C::_stop()
 
 /////////////// Private Methods ////////////////////////////////////////
 
+// Enables the pull-ups and the TWI module, called by begin() and recover()
+void I2C::enable()
+{
+  pullup(1);
+
+  // enable twi module and acks
+  TWCR = _BV(TWEN) | _BV(TWEA);
+}
+
+// Programs the bit rate worked out by setSpeed()
+void I2C::setBitRate(uint8_t bitRate, uint8_t prescalerBits, uint32_t frequency)
+{
+  uint8_t sreg = SREG;
+  cli();
+  TWSR = prescalerBits & 0x03;
+  TWBR = bitRate;
+  speed = frequency;
+  byteTicks = (9 * 250000UL + frequency - 1) / frequency; // 4 µs ticks per 9-bit byte
+  consecutiveErrors = 0;
+  SREG = sreg;
+}
+
+// Halves the SCL frequency down to I2C_SPEED_STANDARD. Above that frequency the
+// prescaler is always 1, so doubling the SCL period is TWBR = 2 * TWBR + 8.
+// Called with interrupts disabled.
+void I2C::lowerSpeed()
+{
+  if (speed / 2 < I2C_SPEED_STANDARD)
+  {
+    return;
+  }
+  TWBR = 2 * TWBR + 8;
+  speed /= 2;
+  byteTicks *= 2;
+}
+
 void I2C::lockUp()
 {
   TWCR = 0;                     // releases SDA and SCL lines to high impedance
   TWCR = _BV(TWEN) | _BV(TWEA); // reinitialize TWI
 }
 
+// Checks whether a single bus operation of the low-level methods has taken too long
+bool I2C::timedOut(uint16_t startingTime)
+{
+  if (!timeOutDelay)
+  {
+    return (false);
+  }
+  return (ticks_since(startingTime) >= 2 * byteTicks + timeOutDelay / 4);
+}
+
+// Resets the progress of the transaction at the head of the queue and sizes
+// its time out. Called with interrupts disabled.
+void I2C::beginTransaction()
+{
+  I2CTransaction *transaction = queue[queueTail & (I2C_QUEUE_SIZE - 1)];
+
+  stage = 1;
+  position = 0;
+  transactionsStarted++;
+
+  // START, address, register, repeated START and address, the data and STOP
+  uint32_t limit = 2UL * (transaction->length + 5) * byteTicks + timeOutDelay / 4;
+  activeLimit = (limit < I2C_TIMEOUT_MAX_TICKS) ? limit : I2C_TIMEOUT_MAX_TICKS;
+  activeSince = ticks_elapsed();
+}
+
+// Sends the START condition of the transaction at the head of the queue.
+// Called with interrupts disabled.
+void I2C::start()
+{
+  while (TWCR & _BV(TWSTO))
+    ; // The STOP of the previous transaction is still being sent
+
+  beginTransaction();
+  TWCR = TWI_CONTINUE | _BV(TWSTA);
+}
+
+// Completes the active transaction with the given status, sends a STOP and
+// starts the next queued transaction. Called with interrupts disabled.
+void I2C::finish(uint8_t status)
+{
+  I2CTransaction *transaction = queue[queueTail & (I2C_QUEUE_SIZE - 1)];
+  queueTail++;
+
+#if I2C_TRACE_SIZE
+  trace(transaction, status); // Before the next transaction takes over activeSince
+#endif
+
+  if (queueHead != queueTail)
+  {
+    // STOP followed by the START of the next transaction
+    beginTransaction();
+    TWCR = TWI_CONTINUE | _BV(TWSTO) | _BV(TWSTA);
+  }
+  else
+  {
+    TWCR = _BV(TWINT) | _BV(TWEN) | _BV(TWSTO);
+  }
+
+  // Slow the bus down if it keeps failing at this speed
+  if (status)
+  {
+    if (status > 7)
+    {
+      countError(transaction->address, status); // Time outs are counted by poll()
+    }
+
+    if (++consecutiveErrors >= I2C_FALLBACK_ERRORS)
+    {
+      consecutiveErrors = 0;
+      lowerSpeed();
+    }
+  }
+  else
+  {
+    consecutiveErrors = 0;
+  }
+
+  transaction->status = status;
+  if (transaction->callback)
+  {
+    transaction->callback(transaction);
+  }
+}
+
+#if I2C_TRACE_SIZE
+// Records a completed transaction in the trace, overwriting the oldest entry.
+// Called with interrupts disabled.
+void I2C::trace(I2CTransaction *transaction, uint8_t status)
+{
+  if (traceHeld)
+  {
+    return;
+  }
+
+  I2CTraceEntry *entry = &traceRing[traceEnd & (I2C_TRACE_SIZE - 1)];
+  entry->started = activeSince;
+  entry->duration = ticks_since(activeSince);
+  entry->address = transaction->address;
+  entry->registerAddress = transaction->registerAddress;
+  entry->direction = transaction->direction;
+  entry->length = transaction->length;
+  entry->status = status;
+
+  traceEnd++;
+  if (traceFilled < I2C_TRACE_SIZE)
+  {
+    traceFilled++;
+  }
+}
+#endif
+
+// Finds or adds the statistics entry of a slave address
+// Returns NULL once I2C_STATS_DEVICES addresses are recorded
+I2CDeviceStats *I2C::deviceStats(uint8_t address)
+{
+  for (uint8_t i = 0; i < statsCount; i++)
+  {
+    if (stats[i].address == address)
+    {
+      return (&stats[i]);
+    }
+  }
+  if (statsCount == I2C_STATS_DEVICES)
+  {
+    return (NULL);
+  }
+
+  I2CDeviceStats *entry = &stats[statsCount++];
+  memset(entry, 0, sizeof(I2CDeviceStats));
+  entry->address = address;
+  return (entry);
+}
+
+// Counts a failed transaction of a slave address. error is the TWI status, 1
+// for a time out and 0 for a recovery. Called with interrupts disabled.
+void I2C::countError(uint8_t address, uint8_t error)
+{
+  I2CDeviceStats *entry = deviceStats(address);
+  if (entry == NULL)
+  {
+    return;
+  }
+
+  switch (error)
+  {
+  case 0:
+    entry->recoveries++;
+    break;
+  case 1:
+    entry->timeouts++;
+    break;
+  case MT_SLA_NACK:
+  case MT_DATA_NACK:
+  case MR_SLA_NACK:
+    entry->nacks++;
+    break;
+  case LOST_ARBTRTN:
+    entry->arbitration++;
+    break;
+  default:
+    entry->busErrors++;
+    break;
+  }
+}
+
 I2C I2c = I2C();
+
+// TWI interrupt service routine
+ISR(TWI_vect)
+{
+  I2c.interrupt();
+}
@@ -27,7 +27,9 @@
 #ifndef I2C_H
 #define I2C_H
 
+#ifndef F_CPU
 #define F_CPU 16000000
+#endif
 
 #define START 0x08
 #define REPEATED_START 0x10
@@ -48,17 +50,152 @@
 
 #define MAX_BUFFER_SIZE 32
 
+// SCL frequencies in Hz
+#define I2C_SPEED_STANDARD 100000UL
+#define I2C_SPEED_FAST 400000UL
+#define I2C_SPEED_MINIMUM 500UL
+
+// TWBR for a SCL frequency and prescaler (1, 4, 16 or 64) according to
+// SCL = F_CPU / (16 + 2 * TWBR * prescaler)
+#define I2C_TWBR(frequency, prescaler) ((F_CPU / (frequency) - 16) / (2 * (prescaler)))
+
+// TWPS value of the smallest prescaler that keeps TWBR within 8 bits
+#define I2C_TWPS(frequency)                       \
+  (I2C_TWBR(frequency, 1) <= 255    ? 0           \
+   : I2C_TWBR(frequency, 4) <= 255  ? 1           \
+   : I2C_TWBR(frequency, 16) <= 255 ? 2           \
+                                    : 3)
+
+// Consecutive failed transactions after which the SCL frequency is halved,
+// but not below I2C_SPEED_STANDARD
+#define I2C_FALLBACK_ERRORS 8
+
+// Number of slave addresses error statistics are kept for
+#define I2C_STATS_DEVICES 4
+
+// Half period of the SCL pulses sent by recover(), 100 kHz
+#define I2C_RECOVERY_HALF_PERIOD_US 5
+
+// Longest time out in 4 µs ticks, below the 256 ms wrap of ticks_elapsed()
+#define I2C_TIMEOUT_MAX_TICKS 60000U
+
+// Number of transactions that can wait for the bus, a power of two
+#define I2C_QUEUE_SIZE 4
+
+// Number of completed transactions kept by the trace, a power of two up to
+// 128. 0 leaves the trace out of the build, so it costs neither RAM nor cycles.
+#ifndef I2C_TRACE_SIZE
+#define I2C_TRACE_SIZE 0
+#endif
+
+// Transaction directions
+#define I2C_WRITE 0
+#define I2C_READ 1
+
+// Status of a transaction that is queued or in progress
+#define I2C_STATUS_BUSY 0xFF
+// Status of a transaction that ended in a bus error (TWI status 0x00)
+#define I2C_STATUS_BUS_ERROR 0xFE
+
+/*
+ * Descriptor of an asynchronous register transfer. It belongs to the caller and
+ * must stay valid until status is no longer I2C_STATUS_BUSY. Writes send length
+ * bytes from buffer starting at registerAddress, reads fill length (at least
+ * one) bytes of buffer. On completion status holds 0 or the error code the
+ * blocking read()/write() would return, and callback, if set, is called from
+ * the TWI interrupt.
+ */
+struct I2CTransaction
+{
+  uint8_t address;
+  uint8_t registerAddress;
+  uint8_t direction;
+  uint16_t length;
+  uint8_t *buffer;
+  void (*callback)(I2CTransaction *transaction);
+  volatile uint8_t status;
+};
+
+// Error counters of one slave address
+struct I2CDeviceStats
+{
+  uint8_t address;
+  uint16_t nacks;       // Address or data byte not acknowledged
+  uint16_t arbitration; // Arbitration lost
+  uint16_t busErrors;   // Illegal START or STOP on the bus
+  uint16_t timeouts;    // Transfer aborted by poll()
+  uint16_t recoveries;  // Bus recoveries after a time out
+};
+
+// A completed transaction as recorded by the trace, times in 4 µs ticks
+struct I2CTraceEntry
+{
+  uint16_t started;  // ticks_elapsed() when the START was sent
+  uint16_t duration; // Ticks from START until completion
+  uint8_t address;
+  uint8_t registerAddress;
+  uint8_t direction;
+  uint16_t length;
+  uint8_t status; // 0 or the error code of the transaction
+};
+
 class I2C
 {
 public:
   I2C();
-  void begin();
+
+  /*
+   * Enables the I2C hardware at the given SCL frequency. Both functions are
+   * inline, so for a constant frequency the compiler works out TWBR and the
+   * prescaler and no division is left in the program.
+   */
+  void begin(uint32_t frequency = I2C_SPEED_STANDARD)
+  {
+    setSpeed(frequency);
+    recover(); // Frees the bus if the MCU was reset in the middle of a transfer and enables the TWI
+  }
+  void setSpeed(uint32_t frequency)
+  {
+    if (frequency > I2C_SPEED_FAST)
+    {
+      frequency = I2C_SPEED_FAST;
+    }
+    if (frequency < I2C_SPEED_MINIMUM)
+    {
+      frequency = I2C_SPEED_MINIMUM;
+    }
+    uint8_t prescalerBits = I2C_TWPS(frequency);
+    setBitRate(I2C_TWBR(frequency, 1 << (2 * prescalerBits)), prescalerBits, frequency);
+  }
+  uint32_t getSpeed();
+
   void end();
   void timeOut(uint16_t);
   void pullup(uint8_t);
   uint8_t receive();
   uint8_t write(uint8_t, uint8_t, uint8_t);
+  uint8_t write(uint8_t, uint8_t, const uint8_t *, uint16_t);
   uint8_t read(uint8_t, uint8_t, uint8_t);
+  uint8_t read(uint8_t, uint8_t, uint8_t *, uint16_t);
+
+  // Interrupt-driven transfers
+  bool submit(I2CTransaction *);
+  uint8_t transfer(I2CTransaction *);
+  void poll();
+  bool idle();
+  void interrupt();
+
+  // Bus recovery and error statistics
+  bool recover();
+  bool getStats(uint8_t, I2CDeviceStats *);
+  uint16_t getRecoveries();
+
+#if I2C_TRACE_SIZE
+  // Transaction trace
+  void holdTrace(bool);
+  uint16_t getTraceEnd();
+  bool getTrace(uint16_t, I2CTraceEntry *);
+#endif
 
   // Low-level methods
   uint8_t _start();
@@ -70,6 +207,18 @@ public:
 
 private:
   void lockUp();
+  void enable();
+  void setBitRate(uint8_t, uint8_t, uint32_t);
+  void lowerSpeed();
+  I2CDeviceStats *deviceStats(uint8_t);
+  void countError(uint8_t, uint8_t);
+  bool timedOut(uint16_t);
+  void beginTransaction();
+  void start();
+  void finish(uint8_t);
+#if I2C_TRACE_SIZE
+  void trace(I2CTransaction *, uint8_t);
+#endif
   uint8_t returnStatus;
   uint8_t nack;
   uint8_t data[MAX_BUFFER_SIZE];
@@ -77,6 +226,31 @@ private:
   static uint8_t bufferIndex;
   static uint8_t totalBytes;
   static uint16_t timeOutDelay;
+
+  // Transaction queue, the active transaction is queue[queueTail]
+  I2CTransaction *queue[I2C_QUEUE_SIZE];
+  volatile uint8_t queueHead;
+  volatile uint8_t queueTail;
+  volatile uint8_t transactionsStarted;
+  uint16_t position; // Next byte of the active transaction's buffer
+  uint8_t stage;     // Error code the active transaction gets if it times out
+  uint16_t activeSince; // ticks_elapsed() when the active transaction started
+  uint16_t activeLimit; // Ticks after which it is aborted
+
+  uint32_t speed;            // SCL frequency in Hz
+  uint16_t byteTicks;        // Duration of a byte on the bus in 4 µs ticks
+  uint8_t consecutiveErrors; // Failed transactions since the last successful one
+
+  I2CDeviceStats stats[I2C_STATS_DEVICES];
+  uint8_t statsCount;
+  uint16_t recoveries;
+
+#if I2C_TRACE_SIZE
+  I2CTraceEntry traceRing[I2C_TRACE_SIZE];
+  volatile uint16_t traceEnd; // Number of transactions recorded, modulo 65536
+  uint8_t traceFilled;        // Valid entries of traceRing
+  volatile bool traceHeld;    // Transactions are not recorded while set
+#endif
 };
 
 extern I2C I2c;
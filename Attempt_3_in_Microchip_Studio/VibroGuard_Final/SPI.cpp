@@ -0,0 +1,95 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <avr/io.h>
+
+#include "board.h"
+#include "SPI.h"
+
+SPI::SPI() : speed(0)
+{
+}
+
+// Function to enable the SPI as master
+void SPI::begin()
+{
+  // SS must be an output, as an input driven low would switch the SPI to slave mode
+  Board::SpiSs::high();
+  Board::SpiSs::output();
+  Board::SpiMosi::output();
+  Board::SpiSck::output();
+
+  configure(SPI_SPEED_MIN, SPI_MODE0);
+}
+
+// Function to disable the SPI, the pins stay outputs
+void SPI::end()
+{
+  SPCR = 0;
+}
+
+// Function to get the SCK frequency of the last configure()
+uint32_t SPI::getSpeed()
+{
+  return speed;
+}
+
+// Function to send a byte and return the byte received at the same time
+uint8_t SPI::transfer(uint8_t data)
+{
+  SPDR = data;
+  while (!(SPSR & _BV(SPIF)))
+    ; // 8 SCK periods
+  return SPDR;
+}
+
+// Function to send a command byte (usually a register address) and read the response bytes
+void SPI::read(uint8_t command, uint8_t *destination, uint16_t numberBytes)
+{
+  transfer(command);
+  for (uint16_t i = 0; i < numberBytes; i++)
+  {
+    destination[i] = transfer(0x00);
+  }
+}
+
+// Function to send a command byte followed by data bytes
+void SPI::write(uint8_t command, const uint8_t *source, uint16_t numberBytes)
+{
+  transfer(command);
+  for (uint16_t i = 0; i < numberBytes; i++)
+  {
+    transfer(source[i]);
+  }
+}
+
+// Function to set the control registers computed by configure()
+void SPI::setControl(uint8_t control, uint8_t doubleSpeed, uint32_t frequency)
+{
+  SPCR = _BV(SPE) | _BV(MSTR) | control;
+  SPSR = doubleSpeed ? _BV(SPI2X) : 0;
+  speed = frequency;
+}
+
+SPI Spi = SPI();
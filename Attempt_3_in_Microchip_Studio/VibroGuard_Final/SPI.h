@@ -0,0 +1,93 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SPI_H
+#define SPI_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000
+#endif
+
+// SCK frequencies in Hz
+#define SPI_SPEED_MAX (F_CPU / 2)
+#define SPI_SPEED_MIN (F_CPU / 128)
+
+// Clock polarity and phase (CPOL and CPHA bits of SPCR)
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+// log2(divider) - 1 of the fastest SCK not above frequency, F_CPU / 2 to F_CPU / 128
+#define SPI_DIVIDER_CODE(frequency)      \
+  ((frequency) >= F_CPU / 2    ? 0       \
+   : (frequency) >= F_CPU / 4  ? 1       \
+   : (frequency) >= F_CPU / 8  ? 2       \
+   : (frequency) >= F_CPU / 16 ? 3       \
+   : (frequency) >= F_CPU / 32 ? 4       \
+   : (frequency) >= F_CPU / 64 ? 5       \
+                               : 6)
+
+// SPR1:0 and SPI2X of a divider code. Odd codes and /128 run without SPI2X.
+#define SPI_SPR(code) ((code) == 6 ? 3 : (code) / 2)
+#define SPI_2X(code) ((code) < 6 && !((code) & 1))
+
+/*
+ * Master driver of the hardware SPI. The caller selects the slave with its
+ * Board pin around every transfer and sets the clock and mode again, so slaves
+ * with different settings can share the bus. Transfers are blocking: at 8 MHz
+ * a byte takes 1 µs, less than an interrupt would cost.
+ */
+class SPI
+{
+public:
+  SPI();
+
+  void begin();
+  void end();
+
+  // Selects clock and mode. Inline, so a constant frequency leaves no
+  // division in the program.
+  void configure(uint32_t frequency, uint8_t mode)
+  {
+    uint8_t code = SPI_DIVIDER_CODE(frequency);
+    setControl(SPI_SPR(code) | mode, SPI_2X(code), F_CPU >> (code + 1));
+  }
+  uint32_t getSpeed();
+
+  uint8_t transfer(uint8_t data);
+  void read(uint8_t command, uint8_t *destination, uint16_t numberBytes);
+  void write(uint8_t command, const uint8_t *source, uint16_t numberBytes);
+
+private:
+  void setControl(uint8_t control, uint8_t doubleSpeed, uint32_t frequency);
+
+  uint32_t speed; // SCK frequency in Hz
+};
+
+extern SPI Spi;
+
+#endif
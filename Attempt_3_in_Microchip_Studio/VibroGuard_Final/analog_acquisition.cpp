@@ -0,0 +1,94 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "analog_acquisition.h"
+
+#ifdef ACQUISITION_ADC
+
+// AVcc reference, left adjusted result
+#define ANALOG_ADMUX ((1 << REFS0) | (1 << ADLAR))
+
+// ADC clock F_CPU / 32 = 500 kHz, fast enough for 8-bit results
+#define ANALOG_PRESCALER ((1 << ADPS2) | (1 << ADPS0))
+
+// Auto trigger source Timer/Counter1 compare match B
+#define ANALOG_TRIGGER ((1 << ADTS2) | (1 << ADTS0))
+
+static uint8_t axis = 0; // Axis of the conversion in progress
+static uint8_t values[ANALOG_AXES];
+
+// Function to set up the ADC for conversions triggered by Timer1 compare match B
+void analog_begin()
+{
+    // Disable the digital input buffers of the analog pins to save power and noise
+    for (uint8_t i = 0; i < ANALOG_AXES; i++)
+    {
+        DIDR0 |= 1 << (ANALOG_FIRST_CHANNEL + i);
+    }
+
+    ADMUX = ANALOG_ADMUX | ANALOG_FIRST_CHANNEL;
+    ADCSRB = ANALOG_TRIGGER;
+    ADCSRA = (1 << ADEN) | ANALOG_PRESCALER;
+}
+
+// Function to start or stop the triggered conversions
+void analog_enable(bool enable)
+{
+    if (enable)
+    {
+        axis = 0;
+        ADMUX = ANALOG_ADMUX | ANALOG_FIRST_CHANNEL;
+        TIFR1 = (1 << OCF1B); // A pending compare match would not trigger, the ADC reacts to its edge
+        ADCSRA = (1 << ADEN) | (1 << ADATE) | (1 << ADIE) | (1 << ADIF) | ANALOG_PRESCALER;
+    }
+    else
+    {
+        ADCSRA = (1 << ADEN) | (1 << ADIF) | ANALOG_PRESCALER;
+    }
+}
+
+// ADC conversion complete interrupt service routine
+ISR(ADC_vect)
+{
+    values[axis] = ADCH;
+
+    if (++axis < ANALOG_AXES)
+    {
+        // Convert the next axis right away. The multiplexer is latched when a
+        // conversion starts, so it can be switched now.
+        ADMUX = ANALOG_ADMUX | (ANALOG_FIRST_CHANNEL + axis);
+        ADCSRA |= (1 << ADSC);
+        return;
+    }
+
+    axis = 0;
+    ADMUX = ANALOG_ADMUX | ANALOG_FIRST_CHANNEL;
+    TIFR1 = (1 << OCF1B); // Arm the trigger for the next compare match
+
+    analog_sample(values[0], values[1], values[2]);
+}
+#endif
@@ -0,0 +1,64 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef ANALOG_ACQUISITION_H
+#define ANALOG_ACQUISITION_H
+
+#include <stdint.h>
+
+/*
+ * Acquisition from analog accelerometers (piezo or IEPE front ends, ADXL335
+ * style parts) on consecutive ADC channels, one per axis.
+ *
+ * Every Timer1 compare match B triggers the conversion of the first axis, the
+ * other axes are converted back to back from ADC_vect, so the three values of
+ * a sample lie within 80 µs of each other. The CPU only enters the interrupt
+ * when a conversion is done, which allows sampling at several kHz. Results are
+ * left adjusted and only ADCH is used, giving the same 0-255 values as the
+ * MPU6050 path.
+ *
+ * Selected by defining ACQUISITION_ADC for the whole project, otherwise the
+ * ADC and its interrupt are left alone.
+ */
+
+// ADC channel of the x axis, y and z follow
+#define ANALOG_FIRST_CHANNEL 0
+#define ANALOG_AXES 3
+
+// Full-scale range (ACC_RANGE_*) the analog front end maps to 0 V - AVcc with
+// 0 g at AVcc / 2
+#ifndef ANALOG_RANGE
+#define ANALOG_RANGE ACC_RANGE_16G
+#endif
+
+// Highest sampling frequency, three conversions at 500 kHz ADC clock take 78 µs
+#define ANALOG_FREQUENCY_UPPER_LIMIT 5000
+
+void analog_begin();
+void analog_enable(bool enable);
+
+// Called from ADC_vect with every complete sample, implemented by the application
+void analog_sample(uint8_t x, uint8_t y, uint8_t z);
+
+#endif
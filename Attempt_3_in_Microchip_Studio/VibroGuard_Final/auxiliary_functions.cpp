@@ -30,10 +30,51 @@ float map_range(float value, float prevLimitLower, float prevLimitUpper, float n
     return nextLimitLower + ((value - prevLimitLower) / (prevLimitUpper - prevLimitLower) * (nextLimitUpper - nextLimitLower));
 }
 
+// Function to set up the mapping from [inLow, inHigh] to [outLow, outHigh]
+RangeMap::RangeMap(int32_t inLow, int32_t inHigh, int32_t outLow, int32_t outHigh)
+    : inLow(inLow), outLow(outLow)
+{
+    int32_t inSpan = inHigh - inLow;
+    int32_t outSpan = outHigh - outLow;
+    uint32_t magnitude = outSpan < 0 ? -outSpan : outSpan;
+
+    // The largest product in map() is about outSpan << shift, keep it below 2^30
+    shift = 0;
+    while (shift < 24 && magnitude < (1UL << (29 - shift)))
+    {
+        shift++;
+    }
+
+    // Round the scale to the nearest step
+    int32_t numerator = outSpan * (int32_t)(1L << shift);
+    scale = (numerator + (numerator < 0 ? -inSpan : inSpan) / 2) / inSpan;
+}
+
+// Function to map a value, rounded down
+int32_t RangeMap::map(int32_t value) const
+{
+    return outLow + (((value - inLow) * scale) >> shift);
+}
+
+// Function to map a value, rounded to the nearest integer
+int32_t RangeMap::mapRounded(int32_t value) const
+{
+    return outLow + (((value - inLow) * scale + (1L << shift >> 1)) >> shift);
+}
+
+// Function to format a value with two decimals into a caller-provided buffer
+// (TO_STRING_SIZE bytes hold any float)
+char *to_string(float value, char *buffer, size_t size)
+{
+    return floatToString(value, buffer, size, 2);
+}
+
+#ifndef HEAP_FREE
+// Function to format a value with two decimals into a string the caller has to free()
 char *to_string(float value)
 {
-    char buffer[15];
-    floatToString(value, buffer, sizeof(buffer), 2);
+    char buffer[TO_STRING_SIZE];
+    to_string(value, buffer, sizeof(buffer));
 
     // Allocate memory for the C-string (+1 for null terminator)
     char *cstr = (char *)malloc(strlen(buffer) + 1);
@@ -45,6 +86,7 @@ char *to_string(float value)
     strcpy(cstr, buffer); // Copy the formatted string to the allocated memory
     return cstr;          // Return the C-string
 }
+#endif
 
 volatile unsigned long timer0_millis_ = 0; // Variable to store elapsed milliseconds
 
@@ -79,9 +121,83 @@ ISR(TIMER0_COMPA_vect)
 unsigned long millis_elapsed()
 {
     unsigned long millis;
-    // Ensure consistent reading (interrupts should be disabled when reading)
-    cli();                   // Disable interrupts
-    millis = timer0_millis_; // Read the millisecond counter
-    sei();                   // Enable interrupts
-    return millis;           // Return the elapsed milliseconds
+    // The counter takes several instructions to read. Read it until two reads
+    // agree instead of disabling interrupts, which would turn them back on when
+    // called from an ISR.
+    do
+    {
+        millis = timer0_millis_;
+    } while (millis != timer0_millis_);
+    return millis; // Return the elapsed milliseconds
+}
+
+// Function to get the elapsed microseconds with 4 µs resolution
+//
+// Combines the millisecond counter with TCNT0 like ticks_elapsed(), reading the
+// counter again after TCNT0 to detect a compare interrupt in between. Safe in
+// ISRs and with interrupts disabled. Wraps around after about 71 minutes.
+unsigned long micros_elapsed()
+{
+    unsigned long millis;
+    uint8_t count, flags;
+
+    do
+    {
+        millis = timer0_millis_;
+        count = TCNT0;
+        flags = TIFR0;
+    } while (millis != timer0_millis_);
+
+    // The counter wrapped but the interrupt has not incremented the milliseconds yet
+    if ((flags & (1 << OCF0A)) && count < TICKS_PER_MILLISECOND / 2)
+    {
+        millis++;
+    }
+
+    return millis * 1000 + count * (1000 / TICKS_PER_MILLISECOND);
+}
+
+// Function to get the time in 4 µs ticks without disabling interrupts
+//
+// Combines the low byte of the millisecond counter with TCNT0. The byte is read
+// again to detect a compare interrupt in between, and a compare match that is
+// still pending (interrupts disabled or called from an ISR) is accounted for,
+// so this is safe and cheap to call anywhere, e.g. in wait loops.
+uint16_t ticks_elapsed()
+{
+    volatile uint8_t *millisLow = (volatile uint8_t *)&timer0_millis_; // AVR is little-endian
+    uint8_t millis, count, flags;
+
+    do
+    {
+        millis = *millisLow;
+        count = TCNT0;
+        flags = TIFR0;
+    } while (millis != *millisLow);
+
+    // The counter wrapped but the interrupt has not incremented the milliseconds yet
+    if ((flags & (1 << OCF0A)) && count < TICKS_PER_MILLISECOND / 2)
+    {
+        millis++;
+    }
+
+    return (uint16_t)millis * TICKS_PER_MILLISECOND + count;
+}
+
+// Function to get the number of ticks since a value returned by ticks_elapsed()
+// Only valid for intervals shorter than 256 ms
+uint16_t ticks_since(uint16_t start)
+{
+    return ticks_between(start, ticks_elapsed());
+}
+
+// Function to get the number of ticks from one value returned by ticks_elapsed()
+// to a later one. Only valid for intervals shorter than 256 ms
+uint16_t ticks_between(uint16_t start, uint16_t end)
+{
+    if (end < start)
+    {
+        end += TICKS_WRAP; // The tick count wrapped around
+    }
+    return end - start;
 }
@@ -31,9 +31,59 @@
 #include <string.h>
 #include "floatToString.h"
 
+// Size of a to_string() buffer
+#define TO_STRING_SIZE 15
+
 float map_range(float value, float prevLimitLower, float prevLimitUpper, float nextLimitLower, float nextLimitUpper);
+
+// Fractional bits of the scale of map_range<>()
+#define MAP_RANGE_SHIFT 16
+
+// Function to map an integer from one range to another without floats
+//
+// The scale is a fixed-point constant computed by the compiler, so a call costs
+// one multiplication and a shift. The result is rounded down, like casting the
+// float map_range() of a positive result. (value - InLow) times the scale must
+// fit in 31 bits.
+template <int32_t InLow, int32_t InHigh, int32_t OutLow, int32_t OutHigh>
+inline int32_t map_range(int32_t value)
+{
+    static const int32_t scale = (int32_t)(((int64_t)(OutHigh - OutLow) << MAP_RANGE_SHIFT) / (InHigh - InLow));
+    return OutLow + (((value - InLow) * scale) >> MAP_RANGE_SHIFT);
+}
+
+// Integer map_range() for limits only known at runtime
+//
+// The constructor does the only division and picks as many fractional bits for
+// the scale as the output span allows, up to 24. map() then costs one
+// multiplication and a shift. Values must lie within the input range.
+class RangeMap
+{
+private:
+    int32_t inLow;
+    int32_t outLow;
+    int32_t scale;
+    uint8_t shift;
+
+public:
+    RangeMap(int32_t inLow, int32_t inHigh, int32_t outLow, int32_t outHigh);
+    int32_t map(int32_t value) const;        // Rounded down
+    int32_t mapRounded(int32_t value) const; // Rounded to the nearest integer
+};
+char *to_string(float value, char *buffer, size_t size);
+#ifndef HEAP_FREE
 char *to_string(float value);
+#endif
 void setup_millis_counter();
 unsigned long millis_elapsed();
+unsigned long micros_elapsed();
+
+// Timer0 ticks are 4 µs long, the tick count wraps around every 256 ms
+#define TICKS_PER_MILLISECOND 250
+#define TICKS_WRAP (256U * TICKS_PER_MILLISECOND)
+
+uint16_t ticks_elapsed();
+uint16_t ticks_since(uint16_t start);
+uint16_t ticks_between(uint16_t start, uint16_t end);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,125 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <avr/io.h>
+#include <stdint.h>
+
+/*
+ * Pins and peripherals that differ between the boards the firmware runs on,
+ * selected at compile time from the MCU. Drivers call the policies of Board
+ * instead of naming ports and registers, so one set of sources builds for
+ * every board. The policies are empty structs of inline functions: nothing is
+ * dispatched at run time and Board::Alert::high() compiles to the same sbi as
+ * PORTB |= _BV(PORTB0).
+ *
+ * This is a partial step: only the pins, the SPI chip select included, and the
+ * console USART are policies. Timer0, Timer1, the TWI and the ADC channels in
+ * use have the same registers on all supported MCUs and their drivers still
+ * access them directly; a board whose MCU differs there needs policies for
+ * them first.
+ */
+
+// A port pin: BOARD_PIN(Alert, B, 0) declares PB0. release() and pullLow()
+// drive it open drain, as an input with pull-up or an output driving low.
+#define BOARD_PIN(name, port, bit)                                   \
+  struct name                                                        \
+  {                                                                  \
+    static void output() { DDR##port |= _BV(bit); }                  \
+    static void high() { PORT##port |= _BV(bit); }                   \
+    static void low() { PORT##port &= ~_BV(bit); }                   \
+    static bool read() { return PIN##port & _BV(bit); }              \
+    static void release()                                            \
+    {                                                                \
+      DDR##port &= ~_BV(bit);                                        \
+      PORT##port |= _BV(bit);                                        \
+    }                                                                \
+    static void pullLow()                                            \
+    {                                                                \
+      PORT##port &= ~_BV(bit);                                       \
+      DDR##port |= _BV(bit);                                         \
+    }                                                                \
+  }
+
+// A USART in asynchronous mode, 8 data bits, no parity, 1 stop bit:
+// BOARD_USART(Console, 0) declares the USART0
+#define BOARD_USART(name, n)                                         \
+  struct name                                                        \
+  {                                                                  \
+    static void begin(uint16_t ubrr)                                 \
+    {                                                                \
+      UBRR##n##H = ubrr >> 8;                                        \
+      UBRR##n##L = ubrr;                                             \
+      UCSR##n##B = _BV(RXEN##n) | _BV(TXEN##n);                      \
+      UCSR##n##C = _BV(UCSZ##n##1) | _BV(UCSZ##n##0);                \
+    }                                                                \
+    static bool readable() { return UCSR##n##A & _BV(RXC##n); }      \
+    static bool writable() { return UCSR##n##A & _BV(UDRE##n); }     \
+    static uint8_t read() { return UDR##n; }                         \
+    static void write(uint8_t data) { UDR##n = data; }               \
+  }
+
+#if defined(BOARD_HEADER)
+
+// A Board defined outside the firmware, -DBOARD_HEADER='"file.h"'. Used by the
+// host benchmarks to replace peripherals of the register model.
+#include BOARD_HEADER
+
+#elif defined(__AVR_ATmega168__) || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328PB__)
+
+// Arduino Nano and Uno. The emulator models this board.
+struct Board
+{
+  BOARD_PIN(Alert, B, 0); // D8, low while an alert is raised
+  BOARD_PIN(Sda, C, 4);
+  BOARD_PIN(Scl, C, 5);
+  BOARD_PIN(SpiSs, B, 2); // Must stay an output for the SPI to remain master
+  BOARD_PIN(SpiMosi, B, 3);
+  BOARD_PIN(SpiSck, B, 5);
+  BOARD_PIN(SensorCs, B, 2); // D10, chip select of an SPI accelerometer
+  BOARD_USART(Console, 0); // USB serial converter
+};
+
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+
+// Arduino Mega
+struct Board
+{
+  BOARD_PIN(Alert, H, 5); // D8 like on the Nano
+  BOARD_PIN(Sda, D, 1);
+  BOARD_PIN(Scl, D, 0);
+  BOARD_PIN(SpiSs, B, 0);
+  BOARD_PIN(SpiMosi, B, 2);
+  BOARD_PIN(SpiSck, B, 1);
+  BOARD_PIN(SensorCs, B, 0); // D53
+  BOARD_USART(Console, 0);
+};
+
+#else
+#error "No board definition for this MCU in board.h"
+#endif
+
+#endif
@@ -0,0 +1,318 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "command_protocol.h"
+#include "uart_communication.h"
+
+static const char okResponse[] PROGMEM = "OK ";
+static const char errorResponse[] PROGMEM = "ERR ";
+static const char errorNames[] PROGMEM = "NONE|UNKNOWN|ARGUMENT|RANGE|LENGTH";
+
+static char line[COMMAND_MAX_LENGTH]; // Command line being received
+static uint8_t lineLength = 0;
+static bool lineOverflow = false;
+static uint16_t errorCount = 0;
+
+// Function to find a token in a '|' separated keyword list stored in program memory
+// Returns the index of the matching keyword or -1 if there is none
+static int8_t find_keyword(const char *keywords, const char *token)
+{
+  int8_t index = 0;
+  const char *position = token;
+  bool matching = true;
+
+  for (;; keywords++)
+  {
+    char keywordChar = pgm_read_byte(keywords);
+
+    if (keywordChar == '|' || keywordChar == '\0')
+    {
+      if (matching && *position == '\0')
+      {
+        return index;
+      }
+      if (keywordChar == '\0')
+      {
+        return -1;
+      }
+
+      // Start comparing against the next keyword
+      index++;
+      position = token;
+      matching = true;
+    }
+    else if (matching && *position == keywordChar)
+    {
+      position++;
+    }
+    else
+    {
+      matching = false;
+    }
+  }
+}
+
+// Function to transmit the keyword at the given index of a '|' separated list
+static void transmit_keyword(const char *keywords, uint8_t index)
+{
+  for (;; keywords++)
+  {
+    char keywordChar = pgm_read_byte(keywords);
+
+    if (keywordChar == '\0')
+    {
+      return;
+    }
+    if (keywordChar == '|')
+    {
+      if (index == 0)
+      {
+        return;
+      }
+      index--;
+    }
+    else if (index == 0)
+    {
+      UART_transmit(keywordChar);
+    }
+  }
+}
+
+// Function to parse a signed decimal integer
+// Returns false if the text is not a number or does not fit into 32 bits
+static bool parse_int(const char *text, int32_t *value)
+{
+  bool negative = false;
+  uint8_t digits = 0;
+  int32_t result = 0;
+
+  if (*text == '-')
+  {
+    negative = true;
+    text++;
+  }
+
+  while (*text >= '0' && *text <= '9')
+  {
+    if (++digits > 9)
+    {
+      return false; // Nine digits always fit into an int32_t
+    }
+    result = result * 10 + (*text++ - '0');
+  }
+
+  if (digits == 0 || *text != '\0')
+  {
+    return false;
+  }
+
+  *value = negative ? -result : result;
+  return true;
+}
+
+// Function to send an error response and count the error
+static void reply_error(const char *name, uint8_t error)
+{
+  errorCount++;
+
+  UART_transmit_string_P(errorResponse);
+  UART_transmit_string(name);
+  UART_transmit(' ');
+  transmit_keyword(errorNames, error);
+  UART_transmit('\n');
+}
+
+// Function to look up and run the command held in the line buffer
+static void dispatch(const Command *table, uint8_t count)
+{
+  // Split the line into the command name and an optional argument
+  char *argument = NULL;
+  for (uint8_t i = 0; line[i] != '\0'; i++)
+  {
+    if (line[i] == ' ')
+    {
+      line[i] = '\0';
+      argument = &line[i + 1];
+      break;
+    }
+  }
+
+  // Find the command in the table
+  Command command;
+  uint8_t index;
+  for (index = 0; index < count; index++)
+  {
+    if (strcmp_P(line, table[index].name) == 0)
+    {
+      memcpy_P(&command, &table[index], sizeof(Command));
+      break;
+    }
+  }
+  if (index == count)
+  {
+    reply_error(line, COMMAND_ERR_UNKNOWN);
+    return;
+  }
+
+  // Convert the argument to the type the command expects
+  int32_t value = 0;
+  if (command.argumentType == ARG_NONE)
+  {
+    if (argument != NULL)
+    {
+      reply_error(line, COMMAND_ERR_ARGUMENT);
+      return;
+    }
+  }
+  else if (argument == NULL)
+  {
+    reply_error(line, COMMAND_ERR_ARGUMENT);
+    return;
+  }
+  else if (command.argumentType == ARG_INT)
+  {
+    if (!parse_int(argument, &value))
+    {
+      reply_error(line, COMMAND_ERR_ARGUMENT);
+      return;
+    }
+    if (value < command.minimum || value > command.maximum)
+    {
+      reply_error(line, COMMAND_ERR_RANGE);
+      return;
+    }
+  }
+  else
+  {
+    value = find_keyword(command.keywords, argument);
+    if (value < 0)
+    {
+      reply_error(line, COMMAND_ERR_ARGUMENT);
+      return;
+    }
+  }
+
+  if (command.flags & COMMAND_FLAG_SILENT)
+  {
+    command.handler(value);
+    return;
+  }
+
+  // Handlers may append " key=value" fields to the response line
+  UART_transmit_string_P(okResponse);
+  UART_transmit_string(line);
+  command.handler(value);
+  UART_transmit('\n');
+}
+
+/*
+ *  Description:
+ *      Collects received characters into the line buffer without blocking and
+ *      runs the matching command from the table once a full line has arrived.
+ *      At most one command is run per call, so the caller keeps control of the
+ *      loop timing. Lines have the form "NAME" or "NAME ARGUMENT" and end with
+ *      '\n' (a preceding '\r' is ignored).
+ *  Parameters:
+ *      table - const Command *
+ *          Command table in program memory
+ *      count - uint8_t
+ *          Number of entries in the table
+ *  Returns:
+ *      none
+ */
+void command_poll(const Command *table, uint8_t count)
+{
+  while (UART_available())
+  {
+    char received_char = UART_receive();
+
+    if (received_char == '\r')
+    {
+      continue;
+    }
+
+    if (received_char != '\n' && received_char != '\0')
+    {
+      if (lineLength < COMMAND_MAX_LENGTH - 1)
+      {
+        line[lineLength++] = received_char;
+      }
+      else
+      {
+        lineOverflow = true; // Keep discarding until the end of the line
+      }
+      continue;
+    }
+
+    line[lineLength] = '\0';
+
+    if (lineOverflow)
+    {
+      reply_error("?", COMMAND_ERR_LENGTH);
+    }
+    else if (lineLength > 0)
+    {
+      dispatch(table, count);
+    }
+
+    lineLength = 0;
+    lineOverflow = false;
+    return;
+  }
+}
+
+// Function to append a " key=value" field to a command response
+void command_reply_field(const char *key, int32_t value)
+{
+  UART_transmit(' ');
+  UART_transmit_string_P(key);
+  UART_transmit('=');
+  UART_transmit_int(value);
+}
+
+// Function to append an unsigned " key=value" field to a command response
+void command_reply_field(const char *key, uint32_t value)
+{
+  UART_transmit(' ');
+  UART_transmit_string_P(key);
+  UART_transmit('=');
+  UART_transmit_uint(value);
+}
+
+// Function to append a " key=KEYWORD" field to a command response
+void command_reply_keyword(const char *key, const char *keywords, uint8_t index)
+{
+  UART_transmit(' ');
+  UART_transmit_string_P(key);
+  UART_transmit('=');
+  transmit_keyword(keywords, index);
+}
+
+// Function to get the number of rejected commands
+uint16_t command_error_count()
+{
+  return errorCount;
+}
@@ -0,0 +1,87 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef COMMAND_PROTOCOL_H
+#define COMMAND_PROTOCOL_H
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+// Longest accepted command line, including the newline
+#define COMMAND_MAX_LENGTH 24
+#define COMMAND_NAME_LENGTH 8
+
+// Argument types accepted by a command
+#define ARG_NONE 0
+#define ARG_INT 1
+#define ARG_ENUM 2
+
+// Command flags
+#define COMMAND_FLAG_SILENT 0x01 // Do not send a response (legacy commands)
+
+// Error codes reported in "ERR" responses
+#define COMMAND_ERR_UNKNOWN 1
+#define COMMAND_ERR_ARGUMENT 2
+#define COMMAND_ERR_RANGE 3
+#define COMMAND_ERR_LENGTH 4
+
+/*
+ * An entry of a command table. Tables are stored in program memory and are
+ * never copied to RAM.
+ *
+ * For ARG_INT commands the argument is range checked against minimum and
+ * maximum before the handler runs. For ARG_ENUM commands keywords points to a
+ * '|' separated list in program memory (e.g. "BLOCK|STREAM") and the handler
+ * receives the index of the matching keyword.
+ */
+struct Command
+{
+  char name[COMMAND_NAME_LENGTH];
+  uint8_t argumentType;
+  uint8_t flags;
+  const char *keywords;
+  int32_t minimum;
+  int32_t maximum;
+  void (*handler)(int32_t argument);
+};
+
+void command_poll(const Command *table, uint8_t count);
+void command_reply_field(const char *key, int32_t value);
+void command_reply_field(const char *key, uint32_t value);
+
+// 16-bit values have overloads of their own, so that an int or a uint8_t
+// argument picks one exactly instead of being ambiguous between the two above
+inline void command_reply_field(const char *key, int16_t value)
+{
+  command_reply_field(key, (int32_t)value);
+}
+
+inline void command_reply_field(const char *key, uint16_t value)
+{
+  command_reply_field(key, (uint32_t)value);
+}
+void command_reply_keyword(const char *key, const char *keywords, uint8_t index);
+uint16_t command_error_count();
+
+#endif
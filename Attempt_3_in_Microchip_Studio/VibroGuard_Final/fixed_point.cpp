@@ -0,0 +1,125 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <avr/pgmspace.h>
+
+#include "fixed_point.h"
+
+// Powers of ten for every digit of a 32-bit value, most significant first
+static const uint32_t powersOfTen[] PROGMEM = {
+    1000000000, 100000000, 10000000, 1000000, 100000, 10000, 1000, 100, 10, 1};
+#define DIGIT_COUNT (sizeof(powersOfTen) / sizeof(powersOfTen[0]))
+
+// Function to format value / 10^decimals with exactly the given number of decimals
+//
+// Writes e.g. "-12.05" for -1205 with 2 decimals into buffer, which needs
+// FIXED_STRING_SIZE bytes, and returns buffer. Every digit is found by
+// subtracting its power of ten, which is cheaper than a 32-bit division on the
+// AVR and needs no printf.
+//
+// The output is what floatToString() prints, which hosts parse: values between
+// -1 and 0 are written without their sign, -37 with 2 decimals as "0.37".
+char *fixed_to_string(int32_t value, uint8_t decimals, char *buffer)
+{
+  char *position = buffer;
+  uint32_t magnitude = value;
+
+  if (decimals > FIXED_DECIMALS_LIMIT)
+  {
+    decimals = FIXED_DECIMALS_LIMIT;
+  }
+  if (value < 0)
+  {
+    magnitude = -magnitude; // Also correct for INT32_MIN
+    if (magnitude >= pgm_read_dword(&powersOfTen[DIGIT_COUNT - 1 - decimals]))
+    {
+      *position++ = '-';
+    }
+  }
+
+  bool leading = true; // Still skipping leading zeros
+  for (uint8_t i = 0; i < DIGIT_COUNT; i++)
+  {
+    uint32_t power = pgm_read_dword(&powersOfTen[i]);
+    uint8_t exponent = DIGIT_COUNT - 1 - i;
+    char digit = '0';
+
+    while (magnitude >= power)
+    {
+      magnitude -= power;
+      digit++;
+    }
+
+    // The integer part has at least its units digit
+    if (leading && digit == '0' && exponent > decimals)
+    {
+      continue;
+    }
+    leading = false;
+
+    if (exponent + 1 == decimals)
+    {
+      *position++ = '.';
+    }
+    *position++ = digit;
+  }
+
+  *position = '\0';
+  return buffer;
+}
+
+// Function to format a value that was rounded up to a whole number the way floatToString() did
+//
+// floatToString() kept the units of the unrounded value and rounded only the
+// decimals, so they carry into "100" instead of the units: 100 with 2
+// decimals, rounded up from 0.996, is written "0.100" and -300 "-2.100". Needs
+// FIXED_STRING_SIZE bytes like fixed_to_string().
+char *fixed_to_string_carried(int32_t value, uint8_t decimals, char *buffer)
+{
+  if (decimals == 0)
+  {
+    return fixed_to_string(value, decimals, buffer);
+  }
+  if (decimals > FIXED_DECIMALS_LIMIT)
+  {
+    decimals = FIXED_DECIMALS_LIMIT;
+  }
+
+  uint32_t unit = pgm_read_dword(&powersOfTen[DIGIT_COUNT - 1 - decimals]);
+  fixed_to_string(value < 0 ? value + unit : value - unit, decimals, buffer);
+
+  // Replace the decimals, all zero, by a one and as many zeros
+  char *position = buffer;
+  while (*position != '.')
+  {
+    position++;
+  }
+  *++position = '1';
+  for (uint8_t i = 0; i < decimals; i++)
+  {
+    *++position = '0';
+  }
+  *++position = '\0';
+  return buffer;
+}
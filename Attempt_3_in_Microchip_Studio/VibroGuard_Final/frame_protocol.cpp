@@ -0,0 +1,64 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <util/crc16.h>
+
+#include "frame_protocol.h"
+#include "uart_communication.h"
+
+/*
+ *  Description:
+ *      Transmits a binary frame. The CRC is computed while the bytes are sent,
+ *      so the payload is never copied.
+ *  Parameters:
+ *      type - uint8_t
+ *          Frame type (FRAME_TYPE_*)
+ *      payload - const uint8_t *
+ *          Payload bytes in RAM
+ *      length - uint8_t
+ *          Number of payload bytes
+ *  Returns:
+ *      none
+ */
+void frame_send(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+  uint16_t crc = 0xFFFF;
+
+  UART_transmit(FRAME_SYNC_0);
+  UART_transmit(FRAME_SYNC_1);
+
+  UART_transmit(type);
+  crc = _crc_xmodem_update(crc, type);
+  UART_transmit(length);
+  crc = _crc_xmodem_update(crc, length);
+
+  for (uint8_t i = 0; i < length; i++)
+  {
+    UART_transmit(payload[i]);
+    crc = _crc_xmodem_update(crc, payload[i]);
+  }
+
+  UART_transmit(crc & 0xFF);
+  UART_transmit(crc >> 8);
+}
@@ -0,0 +1,51 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef FRAME_PROTOCOL_H
+#define FRAME_PROTOCOL_H
+
+#include <stdint.h>
+
+/*
+ * Binary frames share the UART with the text protocol:
+ *
+ *   0xA5 0x5A | type | length | payload[length] | crc16
+ *
+ * Multi-byte fields are little-endian. The CRC is CRC-16/CCITT-FALSE over
+ * type, length and payload. Text output never contains 0xA5, so the host can
+ * find the start of a frame anywhere in the stream.
+ */
+#define FRAME_SYNC_0 0xA5
+#define FRAME_SYNC_1 0x5A
+
+// Frame types
+#define FRAME_TYPE_SAMPLES 0x01   // sequence (u16) | flags (u8) | N x (x, y, z)
+#define FRAME_TYPE_TELEMETRY 0x02 // uptime ms (u32) | static (u16) | free (u16) | stack unused (u16)
+
+// Bits 1:0 of the samples flags hold the accelerometer range (ACC_RANGE_*)
+#define FRAME_FLAGS_RANGE_MASK 0x03
+
+void frame_send(uint8_t type, const uint8_t *payload, uint8_t length);
+
+#endif
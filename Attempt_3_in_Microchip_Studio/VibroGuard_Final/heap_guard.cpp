@@ -0,0 +1,67 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Heap tripwire for builds with HEAP_FREE defined
+//
+// Replaces the allocator with functions that reference a symbol which is never
+// defined. The firmware is built with -ffunction-sections and --gc-sections, so
+// the replacements are discarded and the link succeeds as long as nothing calls
+// them. A call to malloc(), calloc(), realloc() or free(), from the firmware or
+// from a library function, fails the link with an undefined reference to
+// heap_used_in_heap_free_build, so RAM use is bounded by .data, .bss and the stack.
+//
+// Only built for the device; on a host the C library needs its own allocator.
+
+#if defined(HEAP_FREE) && defined(__AVR__)
+
+#include <stddef.h>
+
+extern "C" {
+void heap_used_in_heap_free_build(); // Intentionally never defined
+
+void *malloc(size_t size)
+{
+  heap_used_in_heap_free_build();
+  return NULL;
+}
+
+void *calloc(size_t count, size_t size)
+{
+  heap_used_in_heap_free_build();
+  return NULL;
+}
+
+void *realloc(void *pointer, size_t size)
+{
+  heap_used_in_heap_free_build();
+  return NULL;
+}
+
+void free(void *pointer)
+{
+  heap_used_in_heap_free_build();
+}
+}
+
+#endif
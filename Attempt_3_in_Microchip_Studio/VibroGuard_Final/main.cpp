@@ -27,42 +27,261 @@
 #include <avr/interrupt.h>
 
 #include "Accelerometer.h"
+#include "analog_acquisition.h"
 #include "auxiliary_functions.h"
+#include "board.h"
+#include "command_protocol.h"
+#include "fixed_point.h"
+#include "frame_protocol.h"
+#include "I2C.h"
+#include "memory_usage.h"
+#include "sample_strings.h"
+#include "scheduler.h"
+#include "sensor_bus.h"
 #include "uart_communication.h"
 
 // Definitions for clock frequency and limits
 #define CLOCK_FREQUENCY 16000000
 #define FREQUENCY_LOWER_LIMIT 1
+#ifdef ACQUISITION_ADC
+#define FREQUENCY_UPPER_LIMIT ANALOG_FREQUENCY_UPPER_LIMIT
+#else
 #define FREQUENCY_UPPER_LIMIT 1000
+#endif
 
 #define BUFFER_SIZE 256
 #define SAMPLING_FREQUENCY 200
 
 #define ALERT_RETAIN_TIME 1000
+#define ALERT_CHECK_PERIOD 10 // Milliseconds between checks of the alert timeout
+
+// Telemetry frames are sent every 1 to TELEMETRY_PERIOD_LIMIT seconds once
+// enabled with the TELEM command
+#define TELEMETRY_PERIOD_LIMIT 60
+#define TELEMETRY_PAYLOAD_SIZE 10
+
+// Streaming mode sends a frame every STREAM_FRAME_SAMPLES samples from the
+// acquisition ring instead of waiting for a full block.
+#define STREAM_FRAME_SAMPLES 8
+
+// The stream ring is indexed with free-running 8-bit counters
+#if (BUFFER_SIZE & (BUFFER_SIZE - 1)) || (BUFFER_SIZE > 256)
+#error "BUFFER_SIZE must be a power of two no larger than 256"
+#endif
+
+// Frame mode keeps the last FRAME_WINDOW frames until the host acknowledges
+// them, and sends a new frame only while the host has granted credit.
+#define FRAME_WINDOW 8
+#define FRAME_PAYLOAD_SIZE (3 + 3 * STREAM_FRAME_SAMPLES)
+
+// Retransmission requests are tracked in an 8-bit mask
+#if (FRAME_WINDOW & (FRAME_WINDOW - 1)) || (FRAME_WINDOW > 8)
+#error "FRAME_WINDOW must be a power of two no larger than 8"
+#endif
+
+// Automatic range selection moves to the next larger range when the peak of a
+// block reaches AUTO_RANGE_UPPER and to the next smaller one when it stays below
+// AUTO_RANGE_LOWER, both as the distance of the mapped 0-255 value from zero g
+// (at most 127). The lower limit is below half the upper one, so a block that
+// was just switched down cannot switch straight back up.
+#define AUTO_RANGE_UPPER 115 // 90% of full scale
+#define AUTO_RANGE_LOWER 51  // 40% of full scale
+
+// Index of "AUTO" in rangeKeywords, follows the ACC_RANGE_* values
+#define RANGE_AUTO 4
+
+// Transmission modes
+#define TRANSMISSION_MODE_BLOCK 0
+#define TRANSMISSION_MODE_STREAM 1
+#define TRANSMISSION_MODE_FRAME 2
 
 using namespace std;
 
 const int MPU = 0x68; // MPU6050 I2C address
 
+// Define ACQUISITION_ADC to sample analog accelerometers with the ADC instead of
+// the MPU6050, see analog_acquisition.h.
+//
+// Define ACCELEROMETER_SPI_CS to read an MPU-6000 or MPU-6500 over SPI instead
+// of the MPU6050 over I2C. Its chip select is Board::SensorCs, D10 on the Nano
+// and D53 on the Mega.
+#ifndef ACQUISITION_ADC
+#ifdef ACCELEROMETER_SPI_CS
+SPIBus<MpuSpiProtocol, Board::SensorCs> sensorBus(SPI_SPEED_MAX);
+#else
+I2CBus sensorBus(MPU, I2C_SPEED_FAST); // The MPU6050 supports Fast-mode I2C
+#endif
+#endif
+
 // Global variables for accelerometer data and buffer management
 volatile uint8_t AccX = 0, AccY = 0, AccZ = 0;
 volatile uint8_t buffer[3][BUFFER_SIZE];
 volatile bool bufferReady = true;
 volatile int bufferIndex = 0;
+volatile unsigned long blockStartTime = 0; // micros_elapsed() at the first sample of the block
+volatile unsigned long blockEndTime = 0;   // micros_elapsed() at the last sample of the block
+
+// Streaming mode state. The ISR advances streamHead, the main loop advances streamTail.
+volatile uint8_t transmissionMode = TRANSMISSION_MODE_BLOCK;
+volatile uint8_t streamHead = 0;
+uint8_t streamTail = 0;
+uint16_t streamSequence = 0; // Index of the first sample of the next frame
+
+// Frame mode retransmit window. Frames between windowTail and windowHead have
+// been sent but not acknowledged, bit n of windowRetransmit marks slot n for
+// retransmission.
+uint8_t frameWindow[FRAME_WINDOW][FRAME_PAYLOAD_SIZE];
+uint8_t windowHead = 0;
+uint8_t windowTail = 0;
+uint8_t windowRetransmit = 0;
+uint16_t frameCredit = 0; // Frames the host is ready to accept
 
 int counterStartValue;
+int samplingFrequency = SAMPLING_FREQUENCY;
+bool samplingEnabled = true;
+#ifdef ACQUISITION_ADC
+uint8_t requestedRange = ANALOG_RANGE; // Fixed by the analog front end
+#else
+uint8_t requestedRange = ACC_RANGE_2G; // Applied at the next block boundary
+#endif
+bool autoRange = false; // Pick requestedRange from the peak of every block
+
+// Statistics reported by the STATS command
+volatile uint32_t samplesAcquired = 0;
+uint32_t blocksSent = 0;
+uint32_t framesSent = 0;
+uint32_t samplesDropped = 0;
+volatile uint32_t samplesSkipped = 0; // Block mode samples taken while the buffer was being sent
+uint32_t framesRetransmitted = 0;
 
+#ifndef ACQUISITION_ADC
 Accelerometer accelerometer;
+#endif
 
 unsigned long alertedTime = 0;
 
+// Mapping of raw samples to hundredths of a g in sampleMapRange
+RangeMap sampleMap(0, 255, -200, 200);
+uint8_t sampleMapRange = ACC_RANGE_2G;
+
 // Function declarations
+void readSensor();
+void storeReadings(struct accComp readings);
+void applyRange();
+uint8_t sampleRange();
+uint8_t autoSelectRange();
+int sampleFullScale();
+void enableSampling(bool enable);
 void setSamplingFrequency(int frequency);
 void printBuffer();
+char *sampleToString(uint8_t raw, uint8_t range, char *buffer);
+void transmitSample(uint8_t raw, uint8_t range);
 void sendBuffer();
+void setTransmissionMode(uint8_t mode);
+uint8_t discardStaleSamples();
+bool sendStreamFrames();
+bool sendSampleFrames();
+uint16_t windowSequence(uint8_t slot);
 void setup();
 void loop();
 
+// Tasks
+void sensorTask();
+void commandTask();
+void transmitTask();
+void alertTask();
+void telemetryTask();
+
+// Command handlers
+void commandAlert(int32_t argument);
+void commandRate(int32_t argument);
+void commandRange(int32_t argument);
+void commandMode(int32_t argument);
+void commandStart(int32_t argument);
+void commandStop(int32_t argument);
+void commandStats(int32_t argument);
+void commandConfig(int32_t argument);
+void commandAck(int32_t argument);
+void commandNak(int32_t argument);
+void commandCredit(int32_t argument);
+void commandI2c(int32_t argument);
+void commandFilter(int32_t argument);
+#if I2C_TRACE_SIZE
+void commandTrace(int32_t argument);
+#endif
+void commandTasks(int32_t argument);
+void commandMemory(int32_t argument);
+void commandTelemetry(int32_t argument);
+
+const char modeKeywords[] PROGMEM = "BLOCK|STREAM|FRAME";
+const char rangeKeywords[] PROGMEM = "2|4|8|16|AUTO"; // Indexed by ACC_RANGE_* and RANGE_AUTO
+const char filterKeywords[] PROGMEM = "260|184|94|44|21|10|5"; // Indexed by ACC_FILTER_*
+
+// UART command table
+//
+// In frame mode the host acknowledges with "ACK <n>" once it holds every sample
+// before index n, asks for a lost frame again with "NAK <sequence>" and grants
+// the number of further frames it can accept with "CREDIT <frames>". ACK is
+// sent for every few frames and has no response to save bandwidth.
+const Command commands[] PROGMEM = {
+    {"A", ARG_NONE, COMMAND_FLAG_SILENT, NULL, 0, 0, commandAlert},
+    {"RATE", ARG_INT, 0, NULL, FREQUENCY_LOWER_LIMIT, FREQUENCY_UPPER_LIMIT, commandRate},
+#ifndef ACQUISITION_ADC
+    {"RANGE", ARG_ENUM, 0, rangeKeywords, 0, 0, commandRange},
+    {"FILTER", ARG_ENUM, 0, filterKeywords, 0, 0, commandFilter},
+#endif
+    {"MODE", ARG_ENUM, 0, modeKeywords, 0, 0, commandMode},
+    {"START", ARG_NONE, 0, NULL, 0, 0, commandStart},
+    {"STOP", ARG_NONE, 0, NULL, 0, 0, commandStop},
+    {"STATS", ARG_NONE, 0, NULL, 0, 0, commandStats},
+    {"CONFIG", ARG_NONE, 0, NULL, 0, 0, commandConfig},
+    {"ACK", ARG_INT, COMMAND_FLAG_SILENT, NULL, 0, 65535, commandAck},
+    {"NAK", ARG_INT, 0, NULL, 0, 65535, commandNak},
+    {"CREDIT", ARG_INT, 0, NULL, 0, 65535, commandCredit},
+    {"I2C", ARG_NONE, 0, NULL, 0, 0, commandI2c},
+#if I2C_TRACE_SIZE
+    {"TRACE", ARG_NONE, 0, NULL, 0, 0, commandTrace},
+#endif
+    {"TASKS", ARG_NONE, 0, NULL, 0, 0, commandTasks},
+    {"MEMORY", ARG_NONE, 0, NULL, 0, 0, commandMemory},
+    {"TELEM", ARG_INT, 0, NULL, 0, TELEMETRY_PERIOD_LIMIT, commandTelemetry},
+};
+#define COMMAND_COUNT (sizeof(commands) / sizeof(commands[0]))
+
+// Task table, highest priority first
+//
+// The sensor is read on every pass because the ISR samples the latest reading.
+// The transmit task is signalled by the ISR when a block or stream frame is
+// complete and by the frame mode commands that let it send more.
+enum
+{
+#ifndef ACQUISITION_ADC
+  TASK_SENSOR,
+#endif
+  TASK_COMMAND,
+  TASK_TRANSMIT,
+  TASK_ALERT,
+  TASK_TELEMETRY,
+  TASK_COUNT
+};
+SCHEDULER_CHECK_TABLE(TASK_COUNT);
+
+const char taskKeywords[] PROGMEM = // Indexed by TASK_*
+#ifndef ACQUISITION_ADC
+    "SENSOR|"
+#endif
+    "COMMAND|TRANSMIT|ALERT|TELEMETRY";
+
+Task tasks[TASK_COUNT] = {
+#ifndef ACQUISITION_ADC
+    TASK(sensorTask, TASK_POLL),
+#endif
+    TASK(commandTask, TASK_POLL),
+    TASK(transmitTask, TASK_EVENT),
+    TASK(alertTask, ALERT_CHECK_PERIOD),
+    TASK(telemetryTask, TASK_EVENT), // Made periodic by TELEM
+};
+
 int main(void)
 {
   setup();
@@ -81,64 +300,167 @@ void setup()
   UART_init(115200); // Initialize UART with baud rate 115200
 
   // Pin type declaration
-  DDRB = DDRB | (1 << PORTB0); // Set PORTB0 as output
+  Board::Alert::output(); // Set the alert pin as output
 
-  accelerometer.begin(MPU); // Initialize accelerometer
+#ifdef ACQUISITION_ADC
+  analog_begin(); // Initialize the ADC
+#else
+  accelerometer.begin(sensorBus); // Initialize accelerometer
+#endif
 
   // Set the sampling frequency for data collection
   setSamplingFrequency(SAMPLING_FREQUENCY);
+
+  scheduler_reset_accounting(tasks, TASK_COUNT);
 }
 
-// Main loop function to continuously read accelerometer data and handle UART communication
+// Main loop function, runs the tasks that are due
 void loop()
 {
-  // Read accelerometer data
-  struct accComp readings;
-  readings = accelerometer.getAcceleration();
+  scheduler_run(tasks, TASK_COUNT);
+}
 
-  // Store accelerometer readings in global variables
-  AccX = readings.AccX; // X-axis value
-  AccY = readings.AccY; // Y-axis value
-  AccZ = readings.AccZ; // Z-axis value
+// Task to read accelerometer data
+void sensorTask()
+{
+  readSensor();
+}
 
+// Task to handle incoming UART commands
+void commandTask()
+{
+  command_poll(commands, COMMAND_COUNT);
+}
+
+// Task to send the samples that are ready in the current transmission mode
+void transmitTask()
+{
+  if (transmissionMode == TRANSMISSION_MODE_STREAM)
+  {
+    // Send any complete frames waiting in the ring, one per run
+    if (sendStreamFrames())
+    {
+      scheduler_signal(&tasks[TASK_TRANSMIT]);
+    }
+  }
+  else if (transmissionMode == TRANSMISSION_MODE_FRAME)
+  {
+    if (sendSampleFrames())
+    {
+      scheduler_signal(&tasks[TASK_TRANSMIT]);
+    }
+  }
   // Check if buffer is full and ready to be sent
-  if (!bufferReady)
+  else if (!bufferReady)
   {
     // Buffer is full. Send data to the computer.
     sendBuffer();
+    blocksSent++;
+
+    // Switch range between blocks so that every block uses a single range
+    if (autoRange)
+    {
+      requestedRange = autoSelectRange();
+    }
+    if (requestedRange != sampleRange())
+    {
+      applyRange();
+    }
 
     // Reset the buffer
     bufferIndex = 0;
     bufferReady = true;
   }
+}
 
+// Task to release the alert output once ALERT_RETAIN_TIME has passed
+void alertTask()
+{
   if (millis_elapsed() - alertedTime >= ALERT_RETAIN_TIME)
   {
-    PORTB = (1 << PORTB0); // Set PORTB0 to HIGH
+    Board::Alert::high(); // Set the alert pin to HIGH
   }
+}
 
-  // Check for incoming UART data
-  if (UART_available())
+// Task to send a telemetry frame with the RAM usage
+void telemetryTask()
+{
+  uint8_t payload[TELEMETRY_PAYLOAD_SIZE];
+  unsigned long uptime = millis_elapsed();
+  uint16_t fields[3] = {memory_static(), memory_free(), memory_stack_unused()};
+
+  for (uint8_t i = 0; i < 4; i++)
   {
-    char *inputSerial = UART_receive_string(); // Receive string from UART
+    payload[i] = uptime >> (8 * i);
+  }
+  for (uint8_t i = 0; i < 3; i++)
+  {
+    payload[4 + 2 * i] = fields[i] & 0xFF;
+    payload[5 + 2 * i] = fields[i] >> 8;
+  }
 
-    // // Convert received string to std::string
-    // char *inputSerial = (char *) malloc(strlen(inputBuffer) + 1); // Allocate memory for the new string
-    // strcpy(inputSerial, inputBuffer); // Copy the received string
+  frame_send(FRAME_TYPE_TELEMETRY, payload, TELEMETRY_PAYLOAD_SIZE);
+}
 
-    // Handle different UART commands
-    if (strcmp(inputSerial, "A\n") == 0)
-    {
-      PORTB = (0 << PORTB0); // Set PORTB0 to LOW
-      alertedTime = millis_elapsed();
-    }
-    // else if (strcmp(inputSerial, "NO_ALERT") == 0)
-    // {
-    //   PORTB = (1 << PORTB0); // Set PORTB0 to HIGH
-    // }
+#ifdef ACQUISITION_ADC
+// Samples are stored by ADC_vect, see analog_sample()
+void readSensor()
+{
+}
 
-    free(inputSerial);
+// The range of the analog front end is fixed
+void applyRange()
+{
+}
+
+// Function to get the range (ACC_RANGE_*) of the samples being acquired
+uint8_t sampleRange()
+{
+  return ANALOG_RANGE;
+}
+#else
+// Function to read the accelerometer into the values sampled by the ISR
+//
+// The accelerometer is read in the background. Each call collects the result of
+// the read started by the previous call and starts the next one, so the I2C
+// transfer overlaps with the UART work of the main loop.
+void readSensor()
+{
+  struct accComp readings;
+  if (accelerometer.collectAcceleration(&readings))
+  {
+    storeReadings(readings);
   }
+
+  accelerometer.requestAcceleration();
+}
+
+// Function to store accelerometer readings in the global variables sampled by the ISR
+void storeReadings(struct accComp readings)
+{
+  AccX = readings.AccX; // X-axis value
+  AccY = readings.AccY; // Y-axis value
+  AccZ = readings.AccZ; // Z-axis value
+}
+
+// Function to switch the accelerometer to the requested range
+void applyRange()
+{
+  accelerometer.setRange(requestedRange);
+  storeReadings(accelerometer.getAcceleration()); // Make sure the ISR only samples values in the new range
+}
+
+// Function to get the range (ACC_RANGE_*) of the samples being acquired
+uint8_t sampleRange()
+{
+  return accelerometer.getRange();
+}
+#endif
+
+// Function to get the full-scale range of the samples being acquired in g
+int sampleFullScale()
+{
+  return 2 << sampleRange();
 }
 
 // Function to set the sampling frequency using timer interrupts
@@ -154,86 +476,667 @@ void setSamplingFrequency(int frequency)
     frequency = FREQUENCY_UPPER_LIMIT;
   }
 
-  TCCR1A = 0;
-  TCCR1B = 0;
+  samplingFrequency = frequency;
 
   // Calculate suitable prescaler values based on the frequency
   int prescaler;
+  uint8_t clockSelect;
   if (frequency <= 10)
   {
     prescaler = 256;
-    TCCR1B |= (1 << CS12);
+    clockSelect = (1 << CS12);
   }
   else if (frequency <= 50)
   {
     prescaler = 64;
-    TCCR1B |= (1 << CS10) | (1 << CS11);
+    clockSelect = (1 << CS10) | (1 << CS11);
   }
   else if (frequency <= 500)
   {
     prescaler = 8;
-    TCCR1B |= (1 << CS11);
+    clockSelect = (1 << CS11);
   }
   else
   {
     prescaler = 1;
-    TCCR1B |= (1 << CS10);
+    clockSelect = (1 << CS10);
   }
 
+  // Reprogram the timer atomically, the ISR reloads TCNT1 from counterStartValue
+  cli();
+
+  TCCR1A = 0;
+#ifdef ACQUISITION_ADC
+  // Clear the counter on compare match A, compare match B triggers the ADC
+  // without software involvement
+  TCCR1B = (1 << WGM12) | clockSelect;
+  OCR1A = CLOCK_FREQUENCY / prescaler / frequency - 1;
+  OCR1B = 0;
+  TCNT1 = 0;
+#else
+  TCCR1B = clockSelect;
+
   // Calculate the counter start value based on the prescaler and frequency
   counterStartValue = 65536 - CLOCK_FREQUENCY / prescaler / frequency;
   TCNT1 = counterStartValue;
+#endif
 
-  // Enable timer interrupts
-  TIMSK1 |= (1 << TOIE1);
+  if (samplingEnabled)
+  {
+    enableSampling(true);
+  }
+
+  sei();
 }
 
-// Timer1 overflow interrupt service routine
-ISR(TIMER1_OVF_vect)
+// Function to start or stop the interrupt that acquires samples
+void enableSampling(bool enable)
 {
+#ifdef ACQUISITION_ADC
+  analog_enable(enable);
+#else
+  if (enable)
+  {
+    TIMSK1 |= (1 << TOIE1);
+  }
+  else
+  {
+    TIMSK1 &= ~(1 << TOIE1);
+  }
+#endif
+}
+
+// Function to store a sample in the block buffer or the stream ring, called from interrupts
+static inline void storeSample(uint8_t x, uint8_t y, uint8_t z)
+{
+  if (transmissionMode != TRANSMISSION_MODE_BLOCK)
+  {
+    // Streaming mode never stops sampling, the ring is drained by the main loop
+    uint8_t slot = streamHead & (BUFFER_SIZE - 1);
+    buffer[0][slot] = x;
+    buffer[1][slot] = y;
+    buffer[2][slot] = z;
+
+    streamHead++;
+    samplesAcquired++;
+
+    if (streamHead % STREAM_FRAME_SAMPLES == 0)
+    {
+      scheduler_signal(&tasks[TASK_TRANSMIT]); // A frame is complete
+    }
+  }
   // Check if the buffer is ready to be filled
-  if (bufferReady)
+  else if (bufferReady)
   {
-    buffer[0][bufferIndex] = AccX;
-    buffer[1][bufferIndex] = AccY;
-    buffer[2][bufferIndex] = AccZ;
+    if (bufferIndex == 0)
+    {
+      blockStartTime = micros_elapsed();
+    }
+
+    buffer[0][bufferIndex] = x;
+    buffer[1][bufferIndex] = y;
+    buffer[2][bufferIndex] = z;
 
     bufferIndex++;
+    samplesAcquired++;
     // Check if the buffer is full
     if (bufferIndex == BUFFER_SIZE)
     {
+      blockEndTime = micros_elapsed();
       bufferReady = false;
+      scheduler_signal(&tasks[TASK_TRANSMIT]);
     }
   }
+  else
+  {
+    // The buffer is still being sent, the sample is lost
+    samplesSkipped++;
+  }
+}
 
-  // Reset the counter to the start value
-  TCNT1 = counterStartValue;
+#ifdef ACQUISITION_ADC
+// Called from ADC_vect once all axes of a sample are converted
+void analog_sample(uint8_t x, uint8_t y, uint8_t z)
+{
+  storeSample(x, y, z);
+}
+#else
+// Timer1 overflow interrupt service routine
+ISR(TIMER1_OVF_vect)
+{
+  // Reload the counter before anything else. Adding the start value keeps the
+  // ticks counted since the overflow, so the sampling period does not depend
+  // on how long the interrupt took to start.
+  TCNT1 += counterStartValue;
+
+  storeSample(AccX, AccY, AccZ);
+}
+#endif
+
+// Function to format a buffered sample in g with two decimals
+//
+// The mapping to hundredths of a g is kept for the last range used, so its
+// scale is only computed again when the range changes. The text is what
+// floatToString() printed, including "0.100" for 0.996 g.
+char *sampleToString(uint8_t raw, uint8_t range, char *buffer)
+{
+  if (range != sampleMapRange)
+  {
+    int32_t limit = (2 << range) * 100;
+    sampleMap = RangeMap(0, 255, -limit, limit);
+    sampleMapRange = range;
+  }
+  int32_t centi = sampleMap.mapRounded(raw);
+
+  // 2 << range is a power of two, so only the ends of the range are whole g.
+  // Any other multiple of 100 was reached by rounding the hundredths up.
+  if (centi % 100 == 0 && raw != 0 && raw != 255)
+  {
+    return fixed_to_string_carried(centi, 2, buffer);
+  }
+  return fixed_to_string(centi, 2, buffer);
+}
+
+// Function to transmit a buffered sample sampled in the given range (ACC_RANGE_*)
+//
+// Samples in the ±2 g range are copied from the precomputed sampleStrings, the
+// others are converted and formatted by sampleToString().
+void transmitSample(uint8_t raw, uint8_t range)
+{
+  if (range == ACC_RANGE_2G)
+  {
+    UART_transmit_string_P(sampleStrings[raw]);
+    return;
+  }
+
+  char text[FIXED_STRING_SIZE];
+  UART_transmit_string(sampleToString(raw, range, text));
 }
 
 // Function to send the buffered data over UART
 void sendBuffer()
 {
+  uint8_t range = sampleRange(); // Range the block was sampled in
+
+  // Tag the block with its range, e.g. "r16", so the host knows its resolution
+  UART_transmit('r');
+  UART_transmit_uint(sampleFullScale());
+  UART_transmit('\n');
+
+  // Tag the block with the time of its first sample in microseconds and the
+  // measured sample period in nanoseconds, e.g. "t1250368,1000000". The period
+  // is split so that slow blocks lasting seconds don't overflow 32 bits.
+  unsigned long duration = blockEndTime - blockStartTime;
+  UART_transmit('t');
+  UART_transmit_uint(blockStartTime);
+  UART_transmit(',');
+  UART_transmit_uint(duration / (BUFFER_SIZE - 1) * 1000 + duration % (BUFFER_SIZE - 1) * 1000 / (BUFFER_SIZE - 1));
+  UART_transmit('\n');
+
   UART_transmit_string_n("x");
   for (int i = 0; i < BUFFER_SIZE; i++)
   {
-    char *value_to_transmit = to_string((map_range(buffer[0][i], 0, 255, -200, 200) / 100.0));
-    UART_transmit_string_n(value_to_transmit);
-    free(value_to_transmit);
+    transmitSample(buffer[0][i], range);
+    UART_transmit('\n');
   }
 
   UART_transmit_string_n("y");
   for (int i = 0; i < BUFFER_SIZE; i++)
   {
-    char *value_to_transmit = to_string((map_range(buffer[1][i], 0, 255, -200, 200) / 100.0));
-    UART_transmit_string_n(value_to_transmit);
-    free(value_to_transmit);
+    transmitSample(buffer[1][i], range);
+    UART_transmit('\n');
   }
 
   UART_transmit_string_n("z");
   for (int i = 0; i < BUFFER_SIZE; i++)
   {
-    char *value_to_transmit = to_string((map_range(buffer[2][i], 0, 255, -200, 200) / 100.0));
-    UART_transmit_string_n(value_to_transmit);
-    free(value_to_transmit);
+    transmitSample(buffer[2][i], range);
+    UART_transmit('\n');
+  }
+}
+
+// Function to pick the range for the next block from the peak of the block in the buffer
+//
+// The range changes by one step per block, so a single impact cannot throw it
+// from one end to the other.
+uint8_t autoSelectRange()
+{
+  uint8_t peak = 0; // Largest distance from zero g, 0-127
+  for (uint8_t axis = 0; axis < 3; axis++)
+  {
+    for (int i = 0; i < BUFFER_SIZE; i++)
+    {
+      uint8_t value = buffer[axis][i];
+      uint8_t distance = (value >= 128) ? value - 128 : 127 - value;
+      if (distance > peak)
+      {
+        peak = distance;
+      }
+    }
+  }
+
+  uint8_t range = sampleRange();
+  if (peak >= AUTO_RANGE_UPPER && range < ACC_RANGE_16G)
+  {
+    range++; // Close to clipping
   }
+  else if (peak < AUTO_RANGE_LOWER && range > ACC_RANGE_2G)
+  {
+    range--; // Resolution is being wasted
+  }
+  return range;
+}
+
+// Function to switch between block and streaming transmission
+void setTransmissionMode(uint8_t mode)
+{
+  cli(); // Keep the ISR from sampling while the buffer state is reset
+
+  if (mode != TRANSMISSION_MODE_BLOCK)
+  {
+    streamHead = 0;
+    streamTail = 0;
+    streamSequence = 0;
+
+    windowHead = 0;
+    windowTail = 0;
+    windowRetransmit = 0;
+    frameCredit = FRAME_WINDOW; // Enough to start before the first CREDIT
+  }
+  else
+  {
+    bufferIndex = 0;
+    bufferReady = true;
+  }
+  transmissionMode = mode;
+
+  sei();
+}
+
+// Function to send one frame of interleaved samples from the stream ring
+//
+// A frame is a header line "s<sequence>" followed by STREAM_FRAME_SAMPLES lines
+// of "<x>,<y>,<z>". The sequence number is the index of the first sample of the
+// frame, so the host can detect dropped frames from gaps in the sequence.
+// Returns true if a frame was sent.
+bool sendStreamFrames()
+{
+  uint8_t pending = discardStaleSamples();
+
+  // Send a single frame per call so the sensor keeps being read between frames
+  if (pending < STREAM_FRAME_SAMPLES)
+  {
+    return false;
+  }
+
+  UART_transmit('s');
+  UART_transmit_uint(streamSequence);
+  UART_transmit('\n');
+
+  uint8_t range = sampleRange();
+  for (uint8_t i = 0; i < STREAM_FRAME_SAMPLES; i++)
+  {
+    uint8_t slot = (streamTail + i) & (BUFFER_SIZE - 1);
+    for (uint8_t axis = 0; axis < 3; axis++)
+    {
+      transmitSample(buffer[axis][slot], range);
+      UART_transmit(axis < 2 ? ',' : '\n');
+    }
+  }
+
+  streamTail += STREAM_FRAME_SAMPLES;
+  streamSequence += STREAM_FRAME_SAMPLES;
+  framesSent++;
+  return true;
+}
+
+// Function to skip the oldest samples of the stream ring when the ISR is about
+// to overwrite them. The gap shows up in the sequence numbers instead of as
+// misaligned data. Returns the number of samples left in the ring.
+uint8_t discardStaleSamples()
+{
+  uint8_t pending = streamHead - streamTail;
+
+  while (pending > BUFFER_SIZE - 2 * STREAM_FRAME_SAMPLES)
+  {
+    streamTail += STREAM_FRAME_SAMPLES;
+    streamSequence += STREAM_FRAME_SAMPLES;
+    samplesDropped += STREAM_FRAME_SAMPLES;
+    pending -= STREAM_FRAME_SAMPLES;
+  }
+
+  return pending;
+}
+
+// Function to send one binary samples frame, either a retransmission or a new
+// frame from the stream ring
+//
+// New frames are copied into the retransmit window and sent only while the
+// window has room and the host has credit left. A host that stops reading or
+// acknowledging therefore only stalls the window; the ring then discards its
+// oldest samples, which the host sees as a gap in the sequence numbers.
+// Returns true if a frame was sent.
+bool sendSampleFrames()
+{
+  uint8_t pending = discardStaleSamples();
+
+  // Frames the host asked for again go first, oldest slot first
+  if (windowRetransmit)
+  {
+    uint8_t slot = windowTail & (FRAME_WINDOW - 1);
+    while (!(windowRetransmit & (1 << slot)))
+    {
+      slot = (slot + 1) & (FRAME_WINDOW - 1);
+    }
+    windowRetransmit &= ~(1 << slot);
+
+    frame_send(FRAME_TYPE_SAMPLES, frameWindow[slot], FRAME_PAYLOAD_SIZE);
+    framesRetransmitted++;
+    return true;
+  }
+
+  if (pending < STREAM_FRAME_SAMPLES || frameCredit == 0 ||
+      (uint8_t)(windowHead - windowTail) == FRAME_WINDOW)
+  {
+    return false;
+  }
+
+  // Build the payload in its window slot: sequence, flags, interleaved samples
+  uint8_t *payload = frameWindow[windowHead & (FRAME_WINDOW - 1)];
+  payload[0] = streamSequence & 0xFF;
+  payload[1] = streamSequence >> 8;
+  payload[2] = sampleRange() & FRAME_FLAGS_RANGE_MASK;
+
+  uint8_t *sample = payload + 3;
+  for (uint8_t i = 0; i < STREAM_FRAME_SAMPLES; i++)
+  {
+    uint8_t slot = (streamTail + i) & (BUFFER_SIZE - 1);
+    *sample++ = buffer[0][slot];
+    *sample++ = buffer[1][slot];
+    *sample++ = buffer[2][slot];
+  }
+
+  frame_send(FRAME_TYPE_SAMPLES, payload, FRAME_PAYLOAD_SIZE);
+
+  windowHead++;
+  frameCredit--;
+  streamTail += STREAM_FRAME_SAMPLES;
+  streamSequence += STREAM_FRAME_SAMPLES;
+  framesSent++;
+  return true;
+}
+
+// Function to get the sequence number of the frame held in a window slot
+uint16_t windowSequence(uint8_t slot)
+{
+  return frameWindow[slot][0] | (frameWindow[slot][1] << 8);
+}
+
+// "A": raise the alert output for ALERT_RETAIN_TIME
+void commandAlert(int32_t argument)
+{
+  Board::Alert::low(); // Set the alert pin to LOW
+  alertedTime = millis_elapsed();
+}
+
+// "RATE <hz>": change the sampling frequency
+void commandRate(int32_t argument)
+{
+  setSamplingFrequency(argument);
+  command_reply_field(PSTR("rate"), samplingFrequency);
+}
+
+// "RANGE 2|4|8|16|AUTO": change the accelerometer full-scale range
+//
+// "RANGE AUTO" selects the range at every block boundary from the peak of the
+// block, see autoSelectRange(). It acts in BLOCK mode only, where every block
+// is sent after its "r<g>" range tag.
+void commandRange(int32_t argument)
+{
+  autoRange = (argument == RANGE_AUTO);
+  if (autoRange)
+  {
+    command_reply_keyword(PSTR("range"), rangeKeywords, RANGE_AUTO);
+    return; // Takes effect after the current block
+  }
+
+  requestedRange = argument;
+
+  if (transmissionMode != TRANSMISSION_MODE_BLOCK)
+  {
+    // Streaming has no block boundary to wait for. Discard the samples taken
+    // in the old range, the host sees them as a gap in the sequence numbers.
+    applyRange();
+
+    cli();
+    uint8_t pending = streamHead - streamTail;
+    streamTail = streamHead;
+    sei();
+
+    streamSequence += pending;
+    samplesDropped += pending;
+  }
+
+  command_reply_keyword(PSTR("range"), rangeKeywords, requestedRange);
+}
+
+#ifndef ACQUISITION_ADC
+// "FILTER 260|184|94|44|21|10|5": select the low-pass filter bandwidth in Hz
+//
+// Only the filter register is rewritten, so sampling continues without a gap
+void commandFilter(int32_t argument)
+{
+  accelerometer.setLowPassFilter(argument);
+  command_reply_keyword(PSTR("filter"), filterKeywords, accelerometer.getLowPassFilter());
+}
+#endif
+
+// "MODE BLOCK|STREAM|FRAME": select how samples are transmitted
+void commandMode(int32_t argument)
+{
+  setTransmissionMode(argument);
+  command_reply_keyword(PSTR("mode"), modeKeywords, argument);
+}
+
+// "START": resume sampling with an empty buffer
+void commandStart(int32_t argument)
+{
+  samplingEnabled = true;
+  setTransmissionMode(transmissionMode);
+  setSamplingFrequency(samplingFrequency);
+}
+
+// "STOP": stop sampling, no further data is sent
+void commandStop(int32_t argument)
+{
+  samplingEnabled = false;
+  enableSampling(false);
+}
+
+// "STATS": report acquisition and protocol counters
+void commandStats(int32_t argument)
+{
+  cli();
+  uint32_t samples = samplesAcquired;
+  uint32_t skipped = samplesSkipped;
+  sei();
+
+  command_reply_field(PSTR("samples"), samples);
+  command_reply_field(PSTR("blocks"), blocksSent);
+  command_reply_field(PSTR("frames"), framesSent);
+  command_reply_field(PSTR("dropped"), samplesDropped + skipped);
+  command_reply_field(PSTR("retransmits"), framesRetransmitted);
+  command_reply_field(PSTR("cmderrors"), command_error_count());
+}
+
+// "CONFIG": report the current configuration
+void commandConfig(int32_t argument)
+{
+  command_reply_field(PSTR("rate"), samplingFrequency);
+  command_reply_keyword(PSTR("range"), rangeKeywords, autoRange ? RANGE_AUTO : requestedRange);
+  if (autoRange)
+  {
+    command_reply_keyword(PSTR("current"), rangeKeywords, sampleRange());
+  }
+#ifndef ACQUISITION_ADC
+  command_reply_keyword(PSTR("filter"), filterKeywords, accelerometer.getLowPassFilter());
+#endif
+  command_reply_keyword(PSTR("mode"), modeKeywords, transmissionMode);
+  command_reply_field(PSTR("running"), samplingEnabled);
+#if defined(ACQUISITION_ADC)
+  command_reply_field(PSTR("channels"), ANALOG_AXES);
+#elif defined(ACCELEROMETER_SPI_CS)
+  command_reply_field(PSTR("spi"), sensorBus.getSpeed());
+#else
+  command_reply_field(PSTR("i2c"), sensorBus.getSpeed());
+#endif
+}
+
+// "ACK <n>": release the window frames that only hold samples before index n
+void commandAck(int32_t argument)
+{
+  uint16_t acknowledged = argument;
+
+  while (windowTail != windowHead)
+  {
+    uint8_t slot = windowTail & (FRAME_WINDOW - 1);
+
+    // Sequence numbers wrap, compare the distance instead of the values
+    if ((int16_t)(acknowledged - windowSequence(slot)) < STREAM_FRAME_SAMPLES)
+    {
+      break;
+    }
+
+    windowRetransmit &= ~(1 << slot);
+    windowTail++;
+  }
+
+  scheduler_signal(&tasks[TASK_TRANSMIT]); // The window may have room again
+}
+
+// "NAK <sequence>": send the frame starting at the given sample again
+void commandNak(int32_t argument)
+{
+  bool queued = false;
+
+  for (uint8_t frame = windowTail; frame != windowHead; frame++)
+  {
+    uint8_t slot = frame & (FRAME_WINDOW - 1);
+    if (windowSequence(slot) == argument)
+    {
+      windowRetransmit |= (1 << slot);
+      queued = true;
+      break;
+    }
+  }
+
+  // A frame that has left the window can no longer be recovered
+  command_reply_field(PSTR("queued"), queued);
+  scheduler_signal(&tasks[TASK_TRANSMIT]);
+}
+
+// "CREDIT <frames>": set how many new frames may be sent
+void commandCredit(int32_t argument)
+{
+  frameCredit = argument;
+  command_reply_field(PSTR("credit"), frameCredit);
+  scheduler_signal(&tasks[TASK_TRANSMIT]);
+}
+
+// "I2C": report the bus speed, recoveries and the error counters of every slave
+void commandI2c(int32_t argument)
+{
+  command_reply_field(PSTR("speed"), I2c.getSpeed());
+  command_reply_field(PSTR("recoveries"), I2c.getRecoveries());
+
+  I2CDeviceStats device;
+  for (uint8_t i = 0; I2c.getStats(i, &device); i++)
+  {
+    command_reply_field(PSTR("addr"), device.address);
+    command_reply_field(PSTR("nack"), device.nacks);
+    command_reply_field(PSTR("arb"), device.arbitration);
+    command_reply_field(PSTR("buserr"), device.busErrors);
+    command_reply_field(PSTR("timeout"), device.timeouts);
+    command_reply_field(PSTR("recover"), device.recoveries);
+  }
+}
+
+#if I2C_TRACE_SIZE
+// "TRACE": dump the last I2C transactions, oldest first. Recording pauses
+// while the reply is sent. Times are in µs, "at"
+// counts from the START of the first listed transaction. "busy" is the time
+// the bus spent in the listed transactions and "span" the time from the first
+// START to the last completion, so busy / span is the bus occupancy.
+void commandTrace(int32_t argument)
+{
+  I2c.holdTrace(true);
+  uint16_t end = I2c.getTraceEnd();
+  uint16_t number = end - I2C_TRACE_SIZE;
+  I2CTraceEntry entry;
+
+  // Skip entries that were never recorded
+  while (number != end && !I2c.getTrace(number, &entry))
+  {
+    number++;
+  }
+  command_reply_field(PSTR("entries"), (uint16_t)(end - number));
+
+  uint16_t first = (number != end) ? entry.started : 0;
+  uint32_t busy = 0;
+  uint32_t span = 0;
+  for (; number != end && I2c.getTrace(number, &entry); number++)
+  {
+    uint16_t at = ticks_between(first, entry.started);
+    command_reply_field(PSTR("at"), 4 * (uint32_t)at);
+    command_reply_field(PSTR("addr"), entry.address);
+    command_reply_field(PSTR("reg"), entry.registerAddress);
+    command_reply_field(PSTR("dir"), entry.direction);
+    command_reply_field(PSTR("len"), entry.length);
+    command_reply_field(PSTR("st"), entry.status);
+    command_reply_field(PSTR("dur"), 4 * (uint32_t)entry.duration);
+
+    busy += entry.duration;
+    span = at + entry.duration;
+  }
+  command_reply_field(PSTR("busy"), 4 * busy);
+  command_reply_field(PSTR("span"), 4 * span);
+  I2c.holdTrace(false);
+}
+#endif
+
+// "TASKS": report the runtime of every task since the last report, in
+// microseconds, and start a new accounting window
+//
+// load is the share of the window the task ran for, in tenths of a percent.
+void commandTasks(int32_t argument)
+{
+  uint32_t span = scheduler_accounting_span();
+  command_reply_field(PSTR("span"), span);
+
+  for (uint8_t i = 0; i < TASK_COUNT; i++)
+  {
+    Task &task = tasks[i];
+    command_reply_keyword(PSTR("task"), taskKeywords, i);
+    command_reply_field(PSTR("runs"), task.runs);
+    command_reply_field(PSTR("avg"), task.runs ? task.totalTime / task.runs : 0);
+    command_reply_field(PSTR("max"), task.worstTime);
+    command_reply_field(PSTR("load"), span >= 1000 ? task.totalTime / (span / 1000) : 0);
+  }
+
+  scheduler_reset_accounting(tasks, TASK_COUNT);
+}
+
+// "MEMORY": report the RAM usage in bytes, see memory_usage.h
+void commandMemory(int32_t argument)
+{
+  command_reply_field(PSTR("static"), memory_static());
+  command_reply_field(PSTR("free"), memory_free());
+  command_reply_field(PSTR("unused"), memory_stack_unused());
+}
+
+// "TELEM <seconds>": send a telemetry frame every given number of seconds, 0 stops them
+void commandTelemetry(int32_t argument)
+{
+  tasks[TASK_TELEMETRY].period = argument ? argument * 1000 : TASK_EVENT;
+  command_reply_field(PSTR("period"), argument);
 }
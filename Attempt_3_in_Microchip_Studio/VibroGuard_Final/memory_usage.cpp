@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "memory_usage.h"
+
+#ifdef __AVR__
+#include <avr/io.h>
+
+// Symbols provided by the linker script and avr-libc's malloc(). The heap-free
+// build must not refer to __brkval, which would pull in the allocator.
+extern uint8_t __heap_start;
+extern uint8_t __stack;
+#ifndef HEAP_FREE
+extern char *__brkval;
+#endif
+
+// Function to paint the RAM between the end of .bss and the top of the stack
+//
+// Runs from .init3, after the stack pointer and the zero register are set up
+// and before the static constructors and main() use the stack. It is naked
+// and must call nothing, so it doesn't touch the stack it paints. The loop is
+// written in assembly because GCC may turn a C loop into a call of memset(),
+// whose return address would land on the stack being painted.
+void memory_paint_stack() __attribute__((naked, used, section(".init3")));
+void memory_paint_stack()
+{
+  // Z runs from __heap_start up to and including __stack
+  __asm__ __volatile__("    ldi r30, lo8(__heap_start)\n"
+                       "    ldi r31, hi8(__heap_start)\n"
+                       "    ldi r24, %[paint]\n"
+                       "    ldi r25, hi8(__stack + 1)\n"
+                       "    rjmp 2f\n"
+                       "1:  st Z+, r24\n"
+                       "2:  cpi r30, lo8(__stack + 1)\n"
+                       "    cpc r31, r25\n"
+                       "    brlo 1b\n"
+                       :
+                       : [paint] "M"(STACK_PAINT)
+                       : "r24", "r25", "r30", "r31", "memory");
+}
+
+// Function to get the first byte above the heap
+static uint8_t *heap_end()
+{
+#ifdef HEAP_FREE
+  return &__heap_start;
+#else
+  return __brkval ? (uint8_t *)__brkval : &__heap_start;
+#endif
+}
+
+uint16_t memory_static()
+{
+  return &__heap_start - (uint8_t *)RAMSTART;
+}
+
+uint16_t memory_free()
+{
+  return (uint8_t *)SP - heap_end();
+}
+
+uint16_t memory_stack_unused()
+{
+  const uint8_t *p = heap_end();
+  uint16_t unused = 0;
+
+  while (p <= &__stack && *p == STACK_PAINT)
+  {
+    p++;
+    unused++;
+  }
+  return unused;
+}
+#else
+uint16_t memory_static()
+{
+  return 0;
+}
+
+uint16_t memory_free()
+{
+  return 0;
+}
+
+uint16_t memory_stack_unused()
+{
+  return 0;
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef MEMORY_USAGE_H
+#define MEMORY_USAGE_H
+
+#include <stdint.h>
+
+// Value the free RAM between the heap and the stack is painted with at startup
+#define STACK_PAINT 0xC5
+
+/*
+ * RAM usage of the running firmware, in bytes
+ *
+ * memory_static() is the size of .data, .bss and .noinit. memory_free() is
+ * the gap between the top of the heap and the stack pointer right now.
+ * memory_stack_unused() is the part of that gap the stack has never reached
+ * since reset, found by scanning for bytes that still hold STACK_PAINT, so it
+ * is the lowest free RAM seen so far (slightly optimistic if the stack ever
+ * stored STACK_PAINT at its deepest point).
+ *
+ * All of them report 0 when the firmware is not running on the device.
+ */
+uint16_t memory_static();
+uint16_t memory_free();
+uint16_t memory_stack_unused();
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "sample_strings.h"
+
+// A raw sample in the ±2 g range is SAMPLE_OFFSET(raw) * 200 / 255 hundredths
+// of a g. floatToString() printed the units of that value cut towards zero and
+// the rounded hundredths that remain, which reach 100 just below a whole g
+// ("0.100" for 0.996), and no sign while the units are 0. The value is never
+// halfway between two hundredths.
+#define SAMPLE_OFFSET(raw) (2 * (raw) - 255)
+#define SAMPLE_SCALED(raw) ((SAMPLE_OFFSET(raw) < 0 ? -SAMPLE_OFFSET(raw) : SAMPLE_OFFSET(raw)) * 200L)
+#define SAMPLE_UNITS(raw) (SAMPLE_SCALED(raw) / 25500L)
+#define SAMPLE_HUNDREDTHS(raw) ((SAMPLE_SCALED(raw) - SAMPLE_UNITS(raw) * 25500L + 127) / 255)
+
+// Characters before the units digit and after the decimal point
+#define SAMPLE_SIGN(raw) (SAMPLE_OFFSET(raw) < 0 && SAMPLE_UNITS(raw) != 0 ? 1 : 0)
+#define SAMPLE_DECIMALS(raw) (SAMPLE_HUNDREDTHS(raw) == 100 ? 3 : 2)
+
+// Digit i of the hundredths, most significant first
+#define SAMPLE_POWER(raw, i) (SAMPLE_DECIMALS(raw) - (i) == 3 ? 100 : SAMPLE_DECIMALS(raw) - (i) == 2 ? 10 : 1)
+#define SAMPLE_DECIMAL(raw, i) ('0' + SAMPLE_HUNDREDTHS(raw) / SAMPLE_POWER(raw, i) % 10)
+
+// Character i of "d.dd", "-d.dd" or "d.ddd", padded with null characters
+#define SAMPLE_CHAR(raw, i)                                                                              \
+  ((i) < SAMPLE_SIGN(raw) ? '-'                                                                          \
+   : (i) == SAMPLE_SIGN(raw) ? '0' + SAMPLE_UNITS(raw)                                                   \
+   : (i) == SAMPLE_SIGN(raw) + 1 ? '.'                                                                   \
+   : (i) < SAMPLE_SIGN(raw) + 2 + SAMPLE_DECIMALS(raw) ? SAMPLE_DECIMAL(raw, (i) - SAMPLE_SIGN(raw) - 2) \
+   : '\0')
+
+#define SAMPLE_STRING(raw)                                                              \
+  {                                                                                     \
+    SAMPLE_CHAR(raw, 0), SAMPLE_CHAR(raw, 1), SAMPLE_CHAR(raw, 2), SAMPLE_CHAR(raw, 3), \
+    SAMPLE_CHAR(raw, 4), SAMPLE_CHAR(raw, 5)                                            \
+  }
+
+#define SAMPLE_STRINGS_16(raw)                                                                      \
+  SAMPLE_STRING(raw), SAMPLE_STRING(raw + 1), SAMPLE_STRING(raw + 2), SAMPLE_STRING(raw + 3),       \
+  SAMPLE_STRING(raw + 4), SAMPLE_STRING(raw + 5), SAMPLE_STRING(raw + 6), SAMPLE_STRING(raw + 7),   \
+  SAMPLE_STRING(raw + 8), SAMPLE_STRING(raw + 9), SAMPLE_STRING(raw + 10), SAMPLE_STRING(raw + 11), \
+  SAMPLE_STRING(raw + 12), SAMPLE_STRING(raw + 13), SAMPLE_STRING(raw + 14), SAMPLE_STRING(raw + 15)
+
+const char sampleStrings[256][SAMPLE_STRING_SIZE] PROGMEM = {
+    SAMPLE_STRINGS_16(0), SAMPLE_STRINGS_16(16), SAMPLE_STRINGS_16(32), SAMPLE_STRINGS_16(48),
+    SAMPLE_STRINGS_16(64), SAMPLE_STRINGS_16(80), SAMPLE_STRINGS_16(96), SAMPLE_STRINGS_16(112),
+    SAMPLE_STRINGS_16(128), SAMPLE_STRINGS_16(144), SAMPLE_STRINGS_16(160), SAMPLE_STRINGS_16(176),
+    SAMPLE_STRINGS_16(192), SAMPLE_STRINGS_16(208), SAMPLE_STRINGS_16(224), SAMPLE_STRINGS_16(240),
+};
@@ -0,0 +1,44 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SAMPLE_STRINGS_H
+#define SAMPLE_STRINGS_H
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+// Longest strings of sampleStrings, "-2.00" and "0.100", with their terminator
+#define SAMPLE_STRING_SIZE 6
+
+/*
+ * Text of every raw sample in the ±2 g range, as sent in blocks and stream
+ * frames: map_range(raw, 0, 255, -200, 200) / 100.0 as floatToString() prints
+ * it with two decimals, e.g. "-2.00", "1.98" or "0.02" for -0.02 g, and "0.100"
+ * just below a whole g. Host_Tools/format_benchmark checks every string against
+ * a copy of the original floatToString(). The table is stored in program memory
+ * and computed by the compiler.
+ */
+extern const char sampleStrings[256][SAMPLE_STRING_SIZE] PROGMEM;
+
+#endif
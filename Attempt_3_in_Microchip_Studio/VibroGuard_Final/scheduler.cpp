@@ -0,0 +1,124 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "scheduler.h"
+#include "auxiliary_functions.h"
+
+// scheduler_run() keeps one bit per task of a table in a TaskMask
+typedef uint16_t TaskMask;
+#if SCHEDULER_MAX_TASKS > 16
+#error "SCHEDULER_MAX_TASKS must not exceed the 16 bits of TaskMask"
+#endif
+
+// Largest amount by which micros_elapsed() can go backwards between two readings
+#define MICROS_OUT_OF_ORDER 1000L
+
+static uint32_t accountingStart = 0; // micros_elapsed() at the last reset
+
+// Function to get the microseconds since a value returned by micros_elapsed()
+//
+// Two readings can be a few µs out of order when a Timer0 compare match is
+// picked up late, which counts as no time rather than as a wrapped interval.
+// Any other difference is taken as unsigned, so spans up to the 71 minutes of
+// the counter are measured.
+static uint32_t micros_since(uint32_t start)
+{
+  uint32_t elapsed = micros_elapsed() - start;
+  return (elapsed >= (uint32_t)(-MICROS_OUT_OF_ORDER)) ? 0 : elapsed;
+}
+
+// Function to check whether a task is due to run
+static bool task_ready(Task *task)
+{
+  if (task->signalled || task->period == TASK_POLL)
+  {
+    return true;
+  }
+  if (task->period == TASK_EVENT)
+  {
+    return false;
+  }
+  return millis_elapsed() - task->lastStart >= task->period;
+}
+
+// Function to run a task and account for its runtime
+static void task_execute(Task *task)
+{
+  // Clear the signal first so that a signal raised while the task runs isn't lost
+  task->signalled = false;
+  task->lastStart = millis_elapsed();
+
+  uint32_t started = micros_elapsed();
+  task->run();
+  uint32_t duration = micros_since(started);
+
+  task->runs++;
+  task->totalTime += duration;
+  if (duration > task->worstTime)
+  {
+    task->worstTime = duration;
+  }
+}
+
+// Function to run one pass over a task table
+//
+// Every ready task runs at most once per pass. After each run the scan starts
+// over from the top, so a higher priority task that became ready in the
+// meantime runs before the remaining lower priority ones.
+void scheduler_run(Task *table, uint8_t count)
+{
+  TaskMask done = 0; // Bit n is set once table[n] has run in this pass
+
+  for (uint8_t i = 0; i < count;)
+  {
+    if (!(done & ((TaskMask)1 << i)) && task_ready(&table[i]))
+    {
+      task_execute(&table[i]);
+      done |= (TaskMask)1 << i;
+      i = 0;
+    }
+    else
+    {
+      i++;
+    }
+  }
+}
+
+// Function to clear the accounting of all tasks and start a new window
+void scheduler_reset_accounting(Task *table, uint8_t count)
+{
+  for (uint8_t i = 0; i < count; i++)
+  {
+    table[i].runs = 0;
+    table[i].totalTime = 0;
+    table[i].worstTime = 0;
+  }
+  accountingStart = micros_elapsed();
+}
+
+// Function to get the microseconds since the accounting was last reset
+uint32_t scheduler_accounting_span()
+{
+  return micros_since(accountingStart);
+}
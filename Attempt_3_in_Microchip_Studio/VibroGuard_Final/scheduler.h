@@ -0,0 +1,81 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+// Maximum number of tasks in a table, at most 16
+#define SCHEDULER_MAX_TASKS 16
+
+// Compile-time check that a table of count tasks fits, for use at file scope
+#define SCHEDULER_CHECK_TABLE(count) \
+  typedef char scheduler_table_fits[((count) <= SCHEDULER_MAX_TASKS) ? 1 : -1]
+
+// Special task periods
+#define TASK_POLL 0       // Run on every pass
+#define TASK_EVENT 0xFFFF // Run only after scheduler_signal()
+
+/*
+ * An entry of a task table. Tables are listed highest priority first and live
+ * in RAM because they hold the scheduling state and the accounting.
+ *
+ * A periodic task runs every period milliseconds. Any task also runs once
+ * after scheduler_signal(), so an event-triggered task uses TASK_EVENT and a
+ * periodic one can be signalled to run early.
+ *
+ * The accounting covers the time from the start to the end of each run, in
+ * microseconds, including interrupts that fire in between. It wraps around if
+ * it isn't reset within about 71 minutes.
+ */
+struct Task
+{
+  void (*run)();
+  uint16_t period;
+
+  // Scheduling state
+  volatile bool signalled;
+  unsigned long lastStart; // millis_elapsed() at the last start of a periodic task
+
+  // Accounting since the last scheduler_reset_accounting()
+  uint32_t runs;
+  uint32_t totalTime;
+  uint32_t worstTime;
+};
+
+// Initializer of a task table entry
+#define TASK(run, period) {run, period, false, 0, 0, 0, 0}
+
+void scheduler_run(Task *table, uint8_t count);
+void scheduler_reset_accounting(Task *table, uint8_t count);
+uint32_t scheduler_accounting_span();
+
+// Function to make a task run at the next opportunity, safe to call from interrupts
+inline void scheduler_signal(Task *task)
+{
+  task->signalled = true;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <stddef.h>
+
+#include "sensor_bus.h"
+
+// Time allowed beyond the transfer time before the I2C recovers from a lockup, in µs
+#define I2C_BUS_TIMEOUT 200
+
+I2CBus::I2CBus(uint8_t address, uint32_t frequency) : address(address), frequency(frequency)
+{
+  transaction.status = 0;
+}
+
+// Function to enable the I2C, which stays enabled for background transfers
+void I2CBus::begin()
+{
+  I2c.timeOut(I2C_BUS_TIMEOUT);
+  I2c.begin(frequency);
+}
+
+// Function to read consecutive registers
+uint8_t I2CBus::read(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes)
+{
+  return I2c.read(address, registerAddress, destination, numberBytes);
+}
+
+// Function to write consecutive registers
+uint8_t I2CBus::write(uint8_t registerAddress, const uint8_t *source, uint16_t numberBytes)
+{
+  return I2c.write(address, registerAddress, source, numberBytes);
+}
+
+// Function to queue a read of consecutive registers
+// Returns false if the previous request is still running or the I2C queue is full
+bool I2CBus::request(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes)
+{
+  if (transaction.status == I2C_STATUS_BUSY)
+  {
+    return false;
+  }
+
+  transaction.address = address;
+  transaction.registerAddress = registerAddress;
+  transaction.direction = I2C_READ;
+  transaction.length = numberBytes;
+  transaction.buffer = destination;
+  transaction.callback = NULL;
+
+  return I2c.submit(&transaction);
+}
+
+// Function to get the status of the last request
+uint8_t I2CBus::status()
+{
+  return transaction.status;
+}
+
+// Function to time out a hung request
+void I2CBus::poll()
+{
+  I2c.poll();
+}
+
+// Function to get the SCL frequency, lower than requested after a fall back
+uint32_t I2CBus::getSpeed()
+{
+  return I2c.getSpeed();
+}
+
+#ifdef __AVR__
+// Called if a pure virtual function is ever reached. avr-libc has no C++
+// runtime that would provide it.
+extern "C" void __cxa_pure_virtual()
+{
+  while (true)
+    ;
+}
+#endif
@@ -0,0 +1,175 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef SENSOR_BUS_H
+#define SENSOR_BUS_H
+
+#include <stdint.h>
+#include "I2C.h"
+#include "SPI.h"
+
+// Status of a request that is still in progress
+#define SENSOR_BUS_BUSY I2C_STATUS_BUSY
+
+/*
+ * Register access to a sensor, independent of the transport. A driver written
+ * against a register map works over any bus that implements this interface.
+ * All functions return 0 on success or an error code of the transport.
+ *
+ * request() starts a read that completes in the background where the
+ * transport supports it. status() returns SENSOR_BUS_BUSY until the read has
+ * completed, poll() must be called meanwhile to handle time outs.
+ */
+class SensorBus
+{
+public:
+  virtual void begin() = 0;
+  virtual uint8_t read(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes) = 0;
+  virtual uint8_t write(uint8_t registerAddress, const uint8_t *source, uint16_t numberBytes) = 0;
+  virtual bool request(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes) = 0;
+  virtual uint8_t status() = 0;
+  virtual void poll() = 0;
+  virtual uint32_t getSpeed() = 0;
+};
+
+// A slave on the I2C bus, requests run from the TWI interrupt
+class I2CBus : public SensorBus
+{
+public:
+  I2CBus(uint8_t address, uint32_t frequency);
+
+  void begin();
+  uint8_t read(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes);
+  uint8_t write(uint8_t registerAddress, const uint8_t *source, uint16_t numberBytes);
+  bool request(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes);
+  uint8_t status();
+  void poll();
+  uint32_t getSpeed();
+
+private:
+  uint8_t address;
+  uint32_t frequency;
+  I2CTransaction transaction; // Read started by request()
+};
+
+/*
+ * How SPI sensors mark register reads and multi-byte transfers in the address
+ * byte, and how fast their registers may be accessed. Used as the Protocol of
+ * SPIBus, so the same register map driver serves every part of a family.
+ *
+ * READ is set in the address byte of reads and BURST in that of multi-byte
+ * transfers, MODE is the SPI mode. Configuration registers are accessed at
+ * REGISTER_SPEED, request() (the sample reads) at the speed given to SPIBus.
+ */
+struct MpuSpiProtocol // MPU-6000, MPU-6500, MPU-9250: 1 MHz registers, 20 MHz sensor data
+{
+  enum
+  {
+    READ = 0x80,
+    BURST = 0x00, // The register address increments on its own
+    MODE = SPI_MODE3,
+  };
+  static const uint32_t REGISTER_SPEED = 1000000UL;
+};
+
+struct AdxlSpiProtocol // ADXL345, ADXL346: 5 MHz
+{
+  enum
+  {
+    READ = 0x80,
+    BURST = 0x40,
+    MODE = SPI_MODE3,
+  };
+  static const uint32_t REGISTER_SPEED = 5000000UL;
+};
+
+// A slave on the SPI, selected by the Board pin ChipSelect (e.g.
+// Board::SensorCs). Transfers are blocking and take about 1 µs per byte at
+// 8 MHz, request() has completed when it returns.
+template <class Protocol, class ChipSelect>
+class SPIBus : public SensorBus
+{
+public:
+  SPIBus(uint32_t frequency) : frequency(frequency)
+  {
+  }
+
+  void begin()
+  {
+    Spi.begin();
+    ChipSelect::high(); // Deselected
+    ChipSelect::output();
+  }
+
+  uint8_t read(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes)
+  {
+    Spi.configure(Protocol::REGISTER_SPEED, Protocol::MODE);
+    ChipSelect::low();
+    Spi.read(command(Protocol::READ, registerAddress, numberBytes), destination, numberBytes);
+    ChipSelect::high();
+    return 0;
+  }
+
+  uint8_t write(uint8_t registerAddress, const uint8_t *source, uint16_t numberBytes)
+  {
+    Spi.configure(Protocol::REGISTER_SPEED, Protocol::MODE);
+    ChipSelect::low();
+    Spi.write(command(0, registerAddress, numberBytes), source, numberBytes);
+    ChipSelect::high();
+    return 0;
+  }
+
+  bool request(uint8_t registerAddress, uint8_t *destination, uint16_t numberBytes)
+  {
+    Spi.configure(frequency, Protocol::MODE);
+    ChipSelect::low();
+    Spi.read(command(Protocol::READ, registerAddress, numberBytes), destination, numberBytes);
+    ChipSelect::high();
+    return true;
+  }
+
+  uint8_t status()
+  {
+    return 0; // The SPI has no acknowledge, so transfers cannot fail
+  }
+
+  void poll()
+  {
+  }
+
+  uint32_t getSpeed()
+  {
+    return F_CPU >> (SPI_DIVIDER_CODE(frequency) + 1);
+  }
+
+private:
+  static uint8_t command(uint8_t read, uint8_t registerAddress, uint16_t numberBytes)
+  {
+    return read | (numberBytes > 1 ? Protocol::BURST : 0) | registerAddress;
+  }
+
+  uint32_t frequency;
+};
+
+#endif
@@ -22,35 +22,28 @@
  * THE SOFTWARE.
  */
 
+#include "board.h"
 #include "uart_communication.h"
 
-// Function to initialize UART0
+// Function to initialize the console USART of the board
 void UART_init(uint32_t baud_rate)
 {
     uint16_t ubrr_value = round((F_CPU / (16.0 * baud_rate)) - 1); 
     // Calculate the UBRR value for the given baud rate
 
-    // Set baud rate
-    UBRR0H = (ubrr_value >> 8); // Set the high byte of the UBRR register
-    UBRR0L = ubrr_value;        // Set the low byte of the UBRR register
-
-    // Enable receiver and transmitter
-    UCSR0B = (1 << RXEN0) | (1 << TXEN0); // Enable the receiver and transmitter
-
-    // Set frame format: 8 data bits, 1 stop bit, no parity
-    UCSR0C = (1 << UCSZ01) | (3 << UCSZ00); 
-    // Set the frame format to 8 data bits, 1 stop bit, no parity
+    // Set the baud rate, enable receiver and transmitter, 8 data bits, 1 stop bit, no parity
+    Board::Console::begin(ubrr_value);
 }
 
 // Function to transmit a character
 void UART_transmit(unsigned char data)
 {
     // Wait for empty transmit buffer
-    while (!(UCSR0A & (1 << UDRE0)))
+    while (!Board::Console::writable())
         ; // Wait until the transmit buffer is empty
 
     // Put data into buffer, sends the data
-    UDR0 = data; // Transmit the data
+    Board::Console::write(data); // Transmit the data
 }
 
 // Function to transmit a string
@@ -71,25 +64,91 @@ void UART_transmit_string_n(const char *str)
     UART_transmit('\n'); // Transmit a newline character
 }
 
+// Function to transmit a string stored in program memory
+void UART_transmit_string_P(const char *str)
+{
+    char c;
+    while ((c = pgm_read_byte(str++)))
+    {
+        UART_transmit(c); // Transmit each character in the string
+    }
+}
+
+// Function to transmit an unsigned integer in decimal
+void UART_transmit_uint(uint32_t value)
+{
+    char digits[10]; // Enough for the largest 32-bit value
+    uint8_t count = 0;
+
+    // Generate the digits from least to most significant
+    do
+    {
+        digits[count++] = '0' + (value % 10);
+        value /= 10;
+    } while (value);
+
+    while (count)
+    {
+        UART_transmit(digits[--count]); // Transmit the most significant digit first
+    }
+}
+
+// Function to transmit a signed integer in decimal
+void UART_transmit_int(int32_t value)
+{
+    if (value < 0)
+    {
+        UART_transmit('-');
+        UART_transmit_uint(-(uint32_t)value); // Also correct for INT32_MIN
+        return;
+    }
+    UART_transmit_uint(value);
+}
+
 // Function to check if serial data is available to be read
 bool UART_available(void)
 {
-    // Check if RXC0 flag is set (data available to be read)
-    return (UCSR0A & (1 << RXC0)); // Return true if data is available to be read
+    // Check if the receive complete flag is set (data available to be read)
+    return Board::Console::readable(); // Return true if data is available to be read
 }
 
 // Function to receive a character
 char UART_receive(void)
 {
     // Wait for data to be received
-    while (!(UCSR0A & (1 << RXC0)))
+    while (!Board::Console::readable())
         ; // Wait until data is received
 
     // Get and return received data from buffer
-    return UDR0; // Return the received data
+    return Board::Console::read(); // Return the received data
+}
+
+// Function to receive a line into a caller-provided buffer
+//
+// Reads until a newline or null character, which is stored as well, or until
+// the buffer is full. The string is always null terminated. Returns its length.
+uint8_t UART_receive_line(char *buffer, uint8_t size)
+{
+    uint8_t index = 0; // Index to keep track of the string length
+    char received_char;
+
+    while (index < size - 1)
+    {
+        received_char = UART_receive(); // Receive a character
+        buffer[index++] = received_char;
+
+        if (received_char == '\n' || received_char == '\0')
+        {
+            break;
+        }
+    }
+
+    buffer[index] = '\0'; // Add a null terminator to the end of the string
+    return index;
 }
 
-// Function to receive a string
+#ifndef HEAP_FREE
+// Function to receive a string of any length, the caller has to free() it
 char *UART_receive_string(void)
 {
     char *received_string = NULL; // Pointer to store the received string
@@ -130,3 +189,4 @@ char *UART_receive_string(void)
 
     return received_string; // Return the received string
 }
+#endif
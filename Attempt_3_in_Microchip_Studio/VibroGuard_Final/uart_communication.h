@@ -25,9 +25,12 @@
 #ifndef UART_COMMUNICATION_H
 #define UART_COMMUNICATION_H
 
+#ifndef F_CPU
 #define F_CPU 16000000
+#endif
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
@@ -37,9 +40,15 @@ void UART_init(uint32_t baud_rate);
 void UART_transmit(unsigned char data);
 void UART_transmit_string(const char *str);
 void UART_transmit_string_n(const char *str);
+void UART_transmit_string_P(const char *str);
+void UART_transmit_uint(uint32_t value);
+void UART_transmit_int(int32_t value);
 bool UART_available(void);
 char UART_receive(void);
+uint8_t UART_receive_line(char *buffer, uint8_t size);
+#ifndef HEAP_FREE
 char *UART_receive_string(void);
+#endif
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+#!/bin/sh
+# Checks the heap-free build of the firmware (HEAP_FREE, heap_guard.cpp):
+#
+#   1. it links with avr-gcc and the options of the Makefile
+#   2. neither the firmware nor a function of avr-libc it calls pulled in the
+#      allocator of avr-libc or kept one of the guard functions
+#   3. a call of malloc() fails the link with the guard's undefined reference
+#
+# Usage: check_heap_free.sh PROJECT_DIR BUILD_DIR [MCU]
+#
+# PROJECT_DIR holds the Makefile (Attempt_3_in_Microchip_Studio), BUILD_DIR
+# must be an absolute path.
+
+set -u
+project=$1
+build=$2
+mcu=${3:-atmega328p}
+CXX=${CXX:-avr-g++}
+NM=${NM:-avr-nm}
+
+fail()
+{
+  echo "FAIL: $*"
+  exit 1
+}
+
+make -s -C "$project" CXX="$CXX" MCU="$mcu" BUILD="$build" FLAGS=-DHEAP_FREE all || fail "the HEAP_FREE build does not link"
+echo "ok: the HEAP_FREE build links"
+
+if grep -E 'libc\.a\((malloc|calloc|realloc)\.o\)' "$build/VibroGuard_Final.map"; then
+  fail "the allocator of avr-libc is linked in, see $build/VibroGuard_Final.map"
+fi
+if "$NM" "$build/VibroGuard_Final.elf" | grep -wE 'malloc|calloc|realloc|free|__brkval'; then
+  fail "an allocator symbol is left in $build/VibroGuard_Final.elf"
+fi
+echo "ok: no allocator in the image"
+
+# A function that is kept by -u and calls malloc() like firmware code would. The
+# block is stored, GCC removes a malloc() whose result is only freed.
+mkdir -p "$build/heap_probe"
+cat > "$build/heap_probe/heap_probe.cpp" <<'PROBE'
+#include <stdlib.h>
+void *heap_probe_block;
+extern "C" void heap_probe() { heap_probe_block = malloc(1); }
+PROBE
+"$CXX" -mmcu="$mcu" -Os -ffunction-sections -fdata-sections -c -o "$build/heap_probe/heap_probe.o" \
+  "$build/heap_probe/heap_probe.cpp" || fail "cannot compile the probe"
+if "$CXX" -mmcu="$mcu" -Wl,--gc-sections -Wl,-u,heap_probe -o "$build/heap_probe/heap_probe.elf" \
+  "$build"/*.o "$build/heap_probe/heap_probe.o" -lm 2> "$build/heap_probe/link.log"; then
+  fail "a malloc() call links in the HEAP_FREE build"
+fi
+grep -q heap_used_in_heap_free_build "$build/heap_probe/link.log" ||
+  fail "the probe failed to link for another reason, see $build/heap_probe/link.log"
+echo "ok: a malloc() call fails the link"
@@ -0,0 +1,32 @@
+#!/bin/sh
+# Checks the stack painting of the firmware (memory_paint_stack() in
+# memory_usage.cpp) in the disassembly of the device build: it runs from .init3
+# and neither calls anything nor pushes onto the stack it paints.
+#
+# Usage: check_stack_paint.sh PROJECT_DIR BUILD_DIR [MCU]
+#
+# PROJECT_DIR holds the Makefile (Attempt_3_in_Microchip_Studio), BUILD_DIR
+# must be an absolute path.
+
+set -u
+project=$1
+build=$2
+mcu=${3:-atmega328p}
+CXX=${CXX:-avr-g++}
+OBJDUMP=${OBJDUMP:-avr-objdump}
+
+fail()
+{
+  echo "FAIL: $*"
+  exit 1
+}
+
+make -s -C "$project" CXX="$CXX" MCU="$mcu" BUILD="$build" all || fail "the firmware does not build"
+
+"$OBJDUMP" -d -j .init3 "$build/VibroGuard_Final.elf" > "$build/init3.lss" || fail "cannot disassemble .init3"
+grep -q '<memory_paint_stack' "$build/init3.lss" || fail "memory_paint_stack() is not in .init3"
+if grep -E '[[:space:]](call|rcall|icall|eicall|push)[[:space:]]' "$build/init3.lss"; then
+  fail "the stack painting uses the stack, see $build/init3.lss"
+fi
+grep -qE '[[:space:]]st[[:space:]]+Z\+' "$build/init3.lss" || fail "no painting loop in .init3, see $build/init3.lss"
+echo "ok: memory_paint_stack() paints from .init3 without using the stack"
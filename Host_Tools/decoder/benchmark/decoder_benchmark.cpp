@@ -0,0 +1,215 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Decoder throughput benchmark
+//
+// Usage: decoder_benchmark [--mb N] [--chunk BYTES] [recording...]
+//
+// Decodes N MB (default 64) of device output fed in chunks of the given size,
+// as a serial reader would. Recorded streams are replayed repeatedly if given,
+// otherwise a synthetic stream of x/y/z blocks, text stream frames and binary
+// frames formatted like the firmware is used.
+
+#include "vibroguard/stream_decoder.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+using namespace vibroguard;
+
+namespace
+{
+
+class CountingListener : public DecoderListener
+{
+public:
+  void onBlock(const SampleBlock &block) override
+  {
+    // Touch the data the way a consumer would
+    toFloat(block.axis[0], block.count, scratch);
+    checksum += scratch[block.count - 1];
+  }
+
+  void onFrame(const SampleFrame &frame) override { checksum += frame.samples[0]; }
+
+  float scratch[4096];
+  double checksum = 0;
+};
+
+// Formats a sample exactly like floatToString(value, buffer, 15, 2) on the device
+void appendSample(std::string &out, uint8_t raw)
+{
+  float mapped = -200.0f + (raw - 0.0f) / (255.0f - 0.0f) * (200.0f - -200.0f);
+  float value = mapped / 100.0f;
+  int integer = static_cast<int>(value);
+  float fraction = std::fabs(value - static_cast<float>(integer));
+  int decimals = static_cast<int>(fraction * 100 + 0.5f);
+
+  char text[16];
+  int length = std::snprintf(text, sizeof(text), "%d.%02d", integer, decimals);
+  out.append(text, length);
+}
+
+uint8_t waveform(uint32_t sample, int axis)
+{
+  double t = sample / 200.0;
+  double g = 0.8 * std::sin(2 * M_PI * 25 * t + axis) + 0.3 * std::sin(2 * M_PI * 61 * t) + (axis == 2 ? 1.0 : 0.0);
+  long raw = std::lround((g + 2.0) / 4.0 * 255);
+  return static_cast<uint8_t>(raw < 0 ? 0 : raw > 255 ? 255 : raw);
+}
+
+std::string syntheticStream()
+{
+  std::string out;
+  uint32_t sample = 0;
+
+  for (int block = 0; block < 16; block++)
+  {
+    out += "r2\n";
+    out += "t" + std::to_string(block * 256000) + ",1000000\n";
+    for (int axis = 0; axis < 3; axis++)
+    {
+      out += static_cast<char>('x' + axis);
+      out += '\n';
+      for (int i = 0; i < 256; i++)
+      {
+        appendSample(out, waveform(sample + i, axis));
+        out += '\n';
+      }
+    }
+    sample += 256;
+  }
+
+  for (int frame = 0; frame < 64; frame++, sample += 8)
+  {
+    out += 's' + std::to_string(sample & 0xFFFF) + '\n';
+    for (int i = 0; i < 8; i++)
+    {
+      for (int axis = 0; axis < 3; axis++)
+      {
+        appendSample(out, waveform(sample + i, axis));
+        out += (axis < 2) ? ',' : '\n';
+      }
+    }
+  }
+
+  for (int frame = 0; frame < 64; frame++, sample += 32)
+  {
+    std::vector<uint8_t> bytes = {kFrameSync0, kFrameSync1, kFrameTypeSamples, 0,
+                                  static_cast<uint8_t>(sample), static_cast<uint8_t>(sample >> 8), 0};
+    for (int i = 0; i < 32; i++)
+    {
+      for (int axis = 0; axis < 3; axis++)
+      {
+        bytes.push_back(waveform(sample + i, axis));
+      }
+    }
+    bytes[3] = static_cast<uint8_t>(bytes.size() - 4);
+    uint16_t crc = crc16(bytes.data() + 2, bytes.size() - 2);
+    bytes.push_back(static_cast<uint8_t>(crc));
+    bytes.push_back(static_cast<uint8_t>(crc >> 8));
+    out.append(bytes.begin(), bytes.end());
+  }
+
+  return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t megabytes = 64;
+  size_t chunk = 4096;
+  std::string recording;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--mb") == 0 && i + 1 < argc)
+    {
+      megabytes = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else if (std::strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+    {
+      chunk = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      std::ifstream file(argv[i], std::ios::binary);
+      if (!file)
+      {
+        std::fprintf(stderr, "cannot open %s\n", argv[i]);
+        return 1;
+      }
+      recording.append(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+  }
+
+  if (recording.empty())
+  {
+    recording = syntheticStream();
+  }
+  if (chunk == 0)
+  {
+    chunk = 1;
+  }
+
+  // Repeat the recording until the requested size is reached
+  std::string input;
+  size_t target = megabytes << 20;
+  input.reserve(target + recording.size());
+  while (input.size() < target)
+  {
+    input += recording;
+  }
+
+  CountingListener listener;
+  StreamDecoder decoder(listener);
+
+  auto start = std::chrono::steady_clock::now();
+  for (size_t offset = 0; offset < input.size(); offset += chunk)
+  {
+    decoder.feed(input.data() + offset, std::min(chunk, input.size() - offset));
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  double seconds = std::chrono::duration<double>(stop - start).count();
+  const DecoderStats &stats = decoder.stats();
+
+  std::printf("input:   %.1f MB in %zu byte chunks\n", stats.bytes / 1048576.0, chunk);
+  std::printf("decoded: %llu values, %llu blocks, %llu frames, %llu errors\n",
+              static_cast<unsigned long long>(stats.values), static_cast<unsigned long long>(stats.blocks),
+              static_cast<unsigned long long>(stats.frames), static_cast<unsigned long long>(stats.errors));
+  std::printf("time:    %.3f s, %.1f MB/s, %.1f Mvalues/s\n", seconds, stats.bytes / 1048576.0 / seconds,
+              stats.values / 1e6 / seconds);
+  std::printf("checksum %.3f\n", listener.checksum);
+
+  return stats.errors ? 1 : 0;
+}
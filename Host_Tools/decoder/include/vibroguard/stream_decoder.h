@@ -0,0 +1,212 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef VIBROGUARD_STREAM_DECODER_H
+#define VIBROGUARD_STREAM_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vibroguard
+{
+
+// Samples are decoded to hundredths of a g, the resolution the device sends
+constexpr float kCentiToG = 0.01f;
+
+// Binary frame layout (all multi-byte fields little-endian):
+//
+//   0xA5 0x5A | type | length | payload[length] | crc16
+//
+// The CRC is CRC-16/CCITT-FALSE over type, length and payload. Text output
+// never contains the 0xA5 byte, so both formats can share one stream.
+constexpr uint8_t kFrameSync0 = 0xA5;
+constexpr uint8_t kFrameSync1 = 0x5A;
+constexpr size_t kFrameOverhead = 6;
+
+// Range code of a block sent without a "r<g>" range tag
+constexpr uint8_t kRangeUnknown = 0xFF;
+
+// Frame types
+constexpr uint8_t kFrameTypeSamples = 0x01;
+constexpr uint8_t kFrameTypeTelemetry = 0x02;
+
+// Samples payload: sequence (u16) | flags (u8) | N x (x, y, z) raw bytes.
+// Bits 1:0 of flags hold the accelerometer range (0 = ±2g ... 3 = ±16g), a raw
+// byte v maps to (v / 255 * 2 - 1) * full scale like in the firmware.
+constexpr size_t kSamplesHeaderSize = 3;
+
+// Telemetry payload: uptime ms (u32) | static (u16) | free (u16) | stack unused (u16)
+constexpr size_t kTelemetrySize = 10;
+
+enum class DecodeError
+{
+  UnexpectedLine, // Text line that fits no known format
+  BadNumber,      // Sample line that is not a valid number
+  ShortBlock,     // Block axis ended before the expected number of samples
+  ShortFrame,     // Stream frame ended before the expected number of samples
+  BadCrc,         // Binary frame failed the CRC check
+  BadFrame,       // Binary frame with an invalid length for its type
+};
+
+// A complete x/y/z block, planar. Pointers are valid during the callback only.
+struct SampleBlock
+{
+  uint32_t index;     // Number of blocks decoded before this one
+  uint8_t range;      // Range code from the "r<g>" line before the block, or kRangeUnknown
+  bool timed;         // The block had a "t<start>,<period>" line, the two fields below are valid
+  uint32_t startTime; // Device time of the first sample in microseconds, wraps after ~71 minutes
+  uint32_t period;    // Measured sample period in nanoseconds
+  size_t count;       // Samples per axis
+  const int16_t *axis[3];
+};
+
+// A stream frame, interleaved x, y, z. Pointers are valid during the callback only.
+struct SampleFrame
+{
+  uint16_t sequence; // Index of the first sample, modulo 65536
+  uint8_t range;     // Accelerometer range code (binary frames only)
+  size_t count;      // Samples (each is three values)
+  const int16_t *samples;
+};
+
+// RAM usage reported by a telemetry frame, in bytes
+struct Telemetry
+{
+  uint32_t uptime;      // Milliseconds since the device started
+  uint16_t staticRam;   // .data, .bss and .noinit
+  uint16_t freeRam;     // Between the heap and the stack pointer when sent
+  uint16_t stackUnused; // Never reached by the stack since reset
+};
+
+class DecoderListener
+{
+public:
+  virtual ~DecoderListener() = default;
+
+  virtual void onBlock(const SampleBlock &block) { (void)block; }
+  virtual void onFrame(const SampleFrame &frame) { (void)frame; }
+  virtual void onTelemetry(const Telemetry &telemetry) { (void)telemetry; }
+  // Command responses ("OK ..." / "ERR ...")
+  virtual void onResponse(std::string_view line) { (void)line; }
+  // Binary frames of types the decoder does not interpret
+  virtual void onRawFrame(uint8_t type, const uint8_t *payload, size_t length)
+  {
+    (void)type;
+    (void)payload;
+    (void)length;
+  }
+  virtual void onError(DecodeError error) { (void)error; }
+};
+
+struct DecoderStats
+{
+  uint64_t bytes = 0;
+  uint64_t lines = 0;
+  uint64_t values = 0;
+  uint64_t blocks = 0;
+  uint64_t frames = 0;
+  uint64_t errors = 0;
+};
+
+struct DecoderConfig
+{
+  size_t blockSize = 256;      // BUFFER_SIZE of the firmware
+  size_t streamFrameSize = 8;  // STREAM_FRAME_SAMPLES of the firmware
+  size_t maxLineLength = 64;   // Longer lines are discarded as garbage
+  // Limit of "OK ..." and "ERR ..." command responses instead. TASKS, I2C and
+  // TRACE list fields for every task, device and trace entry on one line, a
+  // TRACE of 64 entries is about 4 kB.
+  size_t maxResponseLength = 8192;
+};
+
+/*
+ * Incremental decoder for the device output.
+ *
+ * feed() accepts arbitrary chunks as they are read from the serial port.
+ * Complete lines and frames are parsed in place from the caller's buffer;
+ * only a line or frame that is split across two chunks is copied, once, into
+ * an internal carry buffer. Decoded values are written straight into reused
+ * int16 arrays that the listener receives as views.
+ */
+class StreamDecoder
+{
+public:
+  explicit StreamDecoder(DecoderListener &listener, DecoderConfig config = DecoderConfig());
+
+  void feed(const char *data, size_t size);
+  void reset();
+
+  const DecoderStats &stats() const { return stats_; }
+
+private:
+  enum class TextState
+  {
+    Idle,
+    BlockAxis,
+    StreamFrame,
+  };
+
+  size_t consume(const char *data, size_t size, bool final);
+  size_t consumeFrame(const uint8_t *data, size_t size);
+  void handleLine(const char *line, size_t length);
+  size_t lineLimit(const char *line, size_t length) const;
+  void handleSampleLine(const char *line, size_t length);
+  void handleFrameLine(const char *line, size_t length);
+  void finishAxis();
+  void finishFrame();
+  void emitFrame(uint16_t sequence, uint8_t range, const int16_t *samples, size_t count);
+  void error(DecodeError error);
+
+  DecoderListener &listener_;
+  DecoderConfig config_;
+  DecoderStats stats_;
+
+  std::string carry_; // Incomplete line or frame from the previous chunk
+  bool discarding_ = false;
+
+  TextState state_ = TextState::Idle;
+  int axis_ = -1;
+  uint32_t blockIndex_ = 0;
+  uint8_t blockRange_ = kRangeUnknown;
+  bool blockTimed_ = false;
+  uint32_t blockStartTime_ = 0;
+  uint32_t blockPeriod_ = 0;
+  std::vector<int16_t> block_[3];
+
+  uint16_t frameSequence_ = 0;
+  std::vector<int16_t> frame_;
+};
+
+// Converts decoded hundredths of a g to g
+void toFloat(const int16_t *centi, size_t count, float *out);
+
+// CRC-16/CCITT-FALSE as used by binary frames
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+} // namespace vibroguard
+
+#endif
@@ -0,0 +1,197 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "number_parser.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) && !defined(VIBROGUARD_NO_SIMD)
+#include <emmintrin.h>
+#endif
+
+namespace vibroguard
+{
+
+const char *findNewline(const char *begin, const char *end)
+{
+  const char *position = begin;
+
+#if defined(__SSE2__) && !defined(VIBROGUARD_NO_SIMD)
+  // Compare 16 bytes at a time and pick the first match from the byte mask
+  const __m128i newline = _mm_set1_epi8('\n');
+  while (end - position >= 16)
+  {
+    __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(position));
+    int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+    if (mask)
+    {
+      return position + __builtin_ctz(mask);
+    }
+    position += 16;
+  }
+#endif
+
+  const void *match = std::memchr(position, '\n', end - position);
+  return match ? static_cast<const char *>(match) : end;
+}
+
+// Reference implementation, also used for anything the fast path rejects
+bool parseCentiScalar(const char *text, size_t length, int16_t *value)
+{
+  const char *position = text;
+  const char *end = text + length;
+  bool negative = false;
+
+  if (position < end && (*position == '-' || *position == '+'))
+  {
+    negative = (*position == '-');
+    position++;
+  }
+
+  int32_t integer = 0;
+  int digits = 0;
+  while (position < end && *position >= '0' && *position <= '9')
+  {
+    integer = integer * 10 + (*position++ - '0');
+    if (++digits > 5)
+    {
+      return false;
+    }
+  }
+
+  int32_t fraction = 0;
+  int fractionDigits = 0;
+  bool roundUp = false;
+  if (position < end && *position == '.')
+  {
+    position++;
+    while (position < end && *position >= '0' && *position <= '9')
+    {
+      if (fractionDigits < 2)
+      {
+        fraction = fraction * 10 + (*position - '0');
+      }
+      else if (fractionDigits == 2)
+      {
+        roundUp = (*position >= '5');
+      }
+      fractionDigits++;
+      position++;
+    }
+  }
+
+  if (position != end || (digits == 0 && fractionDigits == 0))
+  {
+    return false;
+  }
+
+  if (fractionDigits == 1)
+  {
+    fraction *= 10;
+  }
+
+  int32_t result = integer * 100 + fraction + (roundUp ? 1 : 0);
+  if (negative)
+  {
+    result = -result;
+  }
+  if (result < INT16_MIN || result > INT16_MAX)
+  {
+    return false;
+  }
+
+  *value = static_cast<int16_t>(result);
+  return true;
+}
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && !defined(VIBROGUARD_NO_SIMD)
+#define VIBROGUARD_SWAR_PARSER 1
+
+// Converts eight ASCII digits held in a little-endian word with three
+// multiplications instead of eight (SIMD within a register)
+static inline uint32_t parseEightDigits(uint64_t word)
+{
+  word -= 0x3030303030303030ULL;
+  word = (word * 10) + (word >> 8);
+  word = (((word & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+          (((word >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >>
+         32;
+  return static_cast<uint32_t>(word);
+}
+
+static inline bool isEightDigits(uint64_t word)
+{
+  return ((word & 0xF0F0F0F0F0F0F0F0ULL) |
+          (((word + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) ==
+         0x3333333333333333ULL;
+}
+#endif
+
+bool parseCenti(const char *text, size_t length, int16_t *value)
+{
+#ifdef VIBROGUARD_SWAR_PARSER
+  // Fast path for what the firmware sends: [-]d{1,3}.dd
+  const char *digits = text;
+  size_t digitsLength = length;
+  bool negative = (length > 0 && *text == '-');
+  if (negative)
+  {
+    digits++;
+    digitsLength--;
+  }
+
+  if (digitsLength >= 4 && digitsLength <= 6 && digits[digitsLength - 3] == '.')
+  {
+    size_t integerLength = digitsLength - 3;
+
+    // Right-align the integer and fraction digits in a word of '0's
+    char word[8];
+    std::memset(word, '0', sizeof(word));
+    std::memcpy(word + 6 - integerLength, digits, integerLength);
+    word[6] = digits[digitsLength - 2];
+    word[7] = digits[digitsLength - 1];
+
+    uint64_t packed;
+    std::memcpy(&packed, word, sizeof(packed));
+    if (isEightDigits(packed))
+    {
+      int32_t result = static_cast<int32_t>(parseEightDigits(packed));
+      if (negative)
+      {
+        result = -result;
+      }
+      if (result >= INT16_MIN && result <= INT16_MAX)
+      {
+        *value = static_cast<int16_t>(result);
+        return true;
+      }
+      return false;
+    }
+  }
+#endif
+
+  return parseCentiScalar(text, length, value);
+}
+
+} // namespace vibroguard
@@ -0,0 +1,48 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef VIBROGUARD_NUMBER_PARSER_H
+#define VIBROGUARD_NUMBER_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace vibroguard
+{
+
+// Returns the first '\n' in [begin, end) or end if there is none. The SSE2 and
+// SWAR fast paths of this file are left out when VIBROGUARD_NO_SIMD is defined.
+const char *findNewline(const char *begin, const char *end);
+
+// Parses a decimal number such as "-1.23" into hundredths (-123). Digits
+// beyond the second decimal are rounded. Returns false for anything that is
+// not a plain decimal number or does not fit into an int16_t.
+bool parseCenti(const char *text, size_t length, int16_t *value);
+
+// parseCenti() without the SWAR fast path, the reference it is tested against
+bool parseCentiScalar(const char *text, size_t length, int16_t *value);
+
+} // namespace vibroguard
+
+#endif
@@ -0,0 +1,560 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "vibroguard/stream_decoder.h"
+#include "number_parser.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+namespace vibroguard
+{
+
+// Raw byte to hundredths of a g for each range code, as the firmware maps it
+static const struct RawLookup
+{
+  int16_t values[4][256];
+
+  RawLookup()
+  {
+    for (int range = 0; range < 4; range++)
+    {
+      double limit = (2 << range) * 100.0;
+      for (int raw = 0; raw < 256; raw++)
+      {
+        values[range][raw] = static_cast<int16_t>(std::lround(-limit + raw / 255.0 * 2 * limit));
+      }
+    }
+  }
+} rawLookup;
+
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc)
+{
+  for (size_t i = 0; i < length; i++)
+  {
+    crc ^= static_cast<uint16_t>(data[i]) << 8;
+    for (int bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? static_cast<uint16_t>((crc << 1) ^ 0x1021) : static_cast<uint16_t>(crc << 1);
+    }
+  }
+  return crc;
+}
+
+void toFloat(const int16_t *centi, size_t count, float *out)
+{
+  // Plain loop so the compiler can vectorize it
+  for (size_t i = 0; i < count; i++)
+  {
+    out[i] = centi[i] * kCentiToG;
+  }
+}
+
+StreamDecoder::StreamDecoder(DecoderListener &listener, DecoderConfig config)
+    : listener_(listener), config_(config)
+{
+  for (auto &axis : block_)
+  {
+    axis.reserve(config_.blockSize);
+  }
+  frame_.reserve(std::max<size_t>(3 * config_.streamFrameSize, 3 * 255));
+  carry_.reserve(std::max<size_t>(config_.maxLineLength, kFrameOverhead + 255));
+}
+
+void StreamDecoder::reset()
+{
+  carry_.clear();
+  discarding_ = false;
+  state_ = TextState::Idle;
+  axis_ = -1;
+  blockRange_ = kRangeUnknown;
+  blockTimed_ = false;
+  frame_.clear();
+}
+
+void StreamDecoder::feed(const char *data, size_t size)
+{
+  const char *position = data;
+  const char *end = data + size;
+  stats_.bytes += size;
+
+  // Drop the rest of an over-long line
+  if (discarding_)
+  {
+    const char *newline = findNewline(position, end);
+    if (newline == end)
+    {
+      return;
+    }
+    position = newline + 1;
+    discarding_ = false;
+  }
+
+  // Complete a line or frame that was split across chunks, copying only the
+  // bytes that belong to it
+  while (!carry_.empty() && position < end)
+  {
+    if (static_cast<uint8_t>(carry_[0]) == kFrameSync0)
+    {
+      if (carry_.size() == 1)
+      {
+        carry_ += *position++;
+      }
+      if (static_cast<uint8_t>(carry_[1]) != kFrameSync1)
+      {
+        error(DecodeError::BadFrame);
+        carry_.erase(0, 1); // Not a frame, resynchronise on the next byte
+        continue;
+      }
+
+      size_t needed = (carry_.size() < 4) ? 4 - carry_.size()
+                                          : kFrameOverhead + static_cast<uint8_t>(carry_[3]) - carry_.size();
+      size_t take = std::min<size_t>(needed, end - position);
+      carry_.append(position, take);
+      position += take;
+
+      if (carry_.size() >= 4 && carry_.size() == kFrameOverhead + static_cast<uint8_t>(carry_[3]))
+      {
+        consume(carry_.data(), carry_.size(), true);
+        carry_.clear();
+      }
+    }
+    else
+    {
+      const char *newline = findNewline(position, end);
+      if (newline == end)
+      {
+        carry_.append(position, end - position);
+        position = end;
+        if (carry_.size() > lineLimit(carry_.data(), carry_.size()))
+        {
+          error(DecodeError::UnexpectedLine);
+          carry_.clear();
+          discarding_ = true;
+        }
+        break;
+      }
+      carry_.append(position, newline + 1 - position);
+      position = newline + 1;
+      consume(carry_.data(), carry_.size(), true);
+      carry_.clear();
+    }
+  }
+
+  if (position == end)
+  {
+    return;
+  }
+
+  size_t used = consume(position, end - position, false);
+  position += used;
+
+  if (position < end)
+  {
+    size_t length = end - position;
+    if (static_cast<uint8_t>(*position) != kFrameSync0 && length > lineLimit(position, length))
+    {
+      error(DecodeError::UnexpectedLine);
+      discarding_ = true;
+      return;
+    }
+    carry_.assign(position, end - position);
+  }
+}
+
+// Returns the length an incomplete line may grow to before it is discarded
+size_t StreamDecoder::lineLimit(const char *line, size_t length) const
+{
+  std::string_view text(line, length);
+  if (text.compare(0, 3, "OK ") == 0 || text.compare(0, 4, "ERR ") == 0)
+  {
+    return config_.maxResponseLength;
+  }
+  return config_.maxLineLength;
+}
+
+// Parses complete lines and frames in place and returns the number of bytes
+// used. With final set the data is known to hold exactly one unit.
+size_t StreamDecoder::consume(const char *data, size_t size, bool final)
+{
+  const char *position = data;
+  const char *end = data + size;
+
+  while (position < end)
+  {
+    if (static_cast<uint8_t>(*position) == kFrameSync0)
+    {
+      size_t used = consumeFrame(reinterpret_cast<const uint8_t *>(position), end - position);
+      if (used == 0)
+      {
+        break; // Incomplete frame
+      }
+      position += used;
+      continue;
+    }
+
+    const char *newline = findNewline(position, end);
+    if (newline == end)
+    {
+      if (final)
+      {
+        handleLine(position, end - position);
+        position = end;
+      }
+      break;
+    }
+
+    handleLine(position, newline - position);
+    position = newline + 1;
+  }
+
+  return position - data;
+}
+
+// Returns the size of the frame at data, or 0 if it is not complete yet
+size_t StreamDecoder::consumeFrame(const uint8_t *data, size_t size)
+{
+  if (size < 2)
+  {
+    return 0;
+  }
+  if (data[1] != kFrameSync1)
+  {
+    error(DecodeError::BadFrame);
+    return 1; // Not a frame, resynchronise on the next byte
+  }
+  if (size < 4)
+  {
+    return 0;
+  }
+
+  uint8_t type = data[2];
+  size_t length = data[3];
+  size_t total = kFrameOverhead + length;
+  if (size < total)
+  {
+    return 0;
+  }
+
+  const uint8_t *payload = data + 4;
+  uint16_t expected = static_cast<uint16_t>(payload[length] | (payload[length + 1] << 8));
+  if (crc16(data + 2, length + 2) != expected)
+  {
+    error(DecodeError::BadCrc);
+    return total;
+  }
+
+  if (type == kFrameTypeSamples)
+  {
+    if (length < kSamplesHeaderSize || (length - kSamplesHeaderSize) % 3 != 0)
+    {
+      error(DecodeError::BadFrame);
+      return total;
+    }
+
+    uint16_t sequence = static_cast<uint16_t>(payload[0] | (payload[1] << 8));
+    uint8_t range = payload[2] & 0x03;
+    size_t values = length - kSamplesHeaderSize;
+    const int16_t *lookup = rawLookup.values[range];
+
+    frame_.resize(values);
+    for (size_t i = 0; i < values; i++)
+    {
+      frame_[i] = lookup[payload[kSamplesHeaderSize + i]];
+    }
+    stats_.values += values;
+    emitFrame(sequence, range, frame_.data(), values / 3);
+    frame_.clear();
+  }
+  else if (type == kFrameTypeTelemetry)
+  {
+    if (length != kTelemetrySize)
+    {
+      error(DecodeError::BadFrame);
+      return total;
+    }
+
+    Telemetry telemetry;
+    telemetry.uptime = payload[0] | (payload[1] << 8) | (payload[2] << 16) | (static_cast<uint32_t>(payload[3]) << 24);
+    telemetry.staticRam = static_cast<uint16_t>(payload[4] | (payload[5] << 8));
+    telemetry.freeRam = static_cast<uint16_t>(payload[6] | (payload[7] << 8));
+    telemetry.stackUnused = static_cast<uint16_t>(payload[8] | (payload[9] << 8));
+    listener_.onTelemetry(telemetry);
+  }
+  else
+  {
+    listener_.onRawFrame(type, payload, length);
+  }
+
+  return total;
+}
+
+void StreamDecoder::handleLine(const char *line, size_t length)
+{
+  if (length > 0 && line[length - 1] == '\r')
+  {
+    length--;
+  }
+  stats_.lines++;
+
+  if (length == 0)
+  {
+    return;
+  }
+
+  // Block axis markers
+  if (length == 1 && line[0] >= 'x' && line[0] <= 'z')
+  {
+    int axis = line[0] - 'x';
+
+    if (state_ == TextState::BlockAxis && block_[axis_].size() != config_.blockSize)
+    {
+      error(DecodeError::ShortBlock);
+    }
+    else if (state_ == TextState::StreamFrame)
+    {
+      error(DecodeError::ShortFrame);
+    }
+    if (axis != axis_ + 1 && axis != 0)
+    {
+      error(DecodeError::ShortBlock); // An axis of this block went missing
+    }
+
+    state_ = TextState::BlockAxis;
+    axis_ = axis;
+    block_[axis].clear();
+    return;
+  }
+
+  // Range tag "r2", "r4", "r8" or "r16" before a block
+  if (line[0] == 'r' && state_ != TextState::StreamFrame)
+  {
+    std::string_view fullScale(line + 1, length - 1);
+    for (uint8_t range = 0; range < 4; range++)
+    {
+      if (fullScale == std::to_string(2 << range))
+      {
+        if (state_ == TextState::BlockAxis)
+        {
+          error(DecodeError::ShortBlock);
+          state_ = TextState::Idle;
+          axis_ = -1;
+        }
+        blockRange_ = range;
+        return;
+      }
+    }
+  }
+
+  // Timestamp tag "t<start us>,<period ns>" before a block
+  if (line[0] == 't' && state_ != TextState::StreamFrame)
+  {
+    const char *end = line + length;
+    uint32_t start = 0, period = 0;
+    auto parsedStart = std::from_chars(line + 1, end, start);
+    if (parsedStart.ec == std::errc() && parsedStart.ptr < end && *parsedStart.ptr == ',')
+    {
+      auto parsedPeriod = std::from_chars(parsedStart.ptr + 1, end, period);
+      if (parsedPeriod.ec == std::errc() && parsedPeriod.ptr == end)
+      {
+        if (state_ == TextState::BlockAxis)
+        {
+          error(DecodeError::ShortBlock);
+          state_ = TextState::Idle;
+          axis_ = -1;
+        }
+        blockTimed_ = true;
+        blockStartTime_ = start;
+        blockPeriod_ = period;
+        return;
+      }
+    }
+  }
+
+  // Stream frame header "s<sequence>"
+  if (line[0] == 's')
+  {
+    uint32_t sequence = 0;
+    size_t i = 1;
+    for (; i < length && line[i] >= '0' && line[i] <= '9'; i++)
+    {
+      sequence = sequence * 10 + (line[i] - '0');
+    }
+    if (i == length && length > 1)
+    {
+      if (state_ == TextState::StreamFrame || state_ == TextState::BlockAxis)
+      {
+        error(state_ == TextState::StreamFrame ? DecodeError::ShortFrame : DecodeError::ShortBlock);
+      }
+      state_ = TextState::StreamFrame;
+      frameSequence_ = static_cast<uint16_t>(sequence);
+      frame_.clear();
+      return;
+    }
+  }
+
+  // Command responses
+  std::string_view text(line, length);
+  if (text.compare(0, 3, "OK ") == 0 || text.compare(0, 4, "ERR ") == 0)
+  {
+    listener_.onResponse(text);
+    return;
+  }
+
+  if (state_ == TextState::BlockAxis)
+  {
+    handleSampleLine(line, length);
+  }
+  else if (state_ == TextState::StreamFrame)
+  {
+    handleFrameLine(line, length);
+  }
+  else
+  {
+    error(DecodeError::UnexpectedLine);
+  }
+}
+
+void StreamDecoder::handleSampleLine(const char *line, size_t length)
+{
+  std::vector<int16_t> &axis = block_[axis_];
+  int16_t value;
+
+  if (axis.size() == config_.blockSize)
+  {
+    error(DecodeError::UnexpectedLine);
+    return;
+  }
+  if (!parseCenti(line, length, &value))
+  {
+    error(DecodeError::BadNumber);
+    value = 0; // Keep the block aligned
+  }
+
+  axis.push_back(value);
+  stats_.values++;
+
+  if (axis_ == 2 && axis.size() == config_.blockSize)
+  {
+    finishAxis();
+  }
+}
+
+void StreamDecoder::handleFrameLine(const char *line, size_t length)
+{
+  // "<x>,<y>,<z>"
+  const char *position = line;
+  const char *end = line + length;
+
+  for (int axis = 0; axis < 3; axis++)
+  {
+    const char *separator = (axis < 2) ? std::find(position, end, ',') : end;
+    int16_t value;
+
+    if (separator == end && axis < 2)
+    {
+      error(DecodeError::BadNumber);
+      return;
+    }
+    if (!parseCenti(position, separator - position, &value))
+    {
+      error(DecodeError::BadNumber);
+      value = 0;
+    }
+
+    frame_.push_back(value);
+    position = separator + 1;
+  }
+  stats_.values += 3;
+
+  if (frame_.size() == 3 * config_.streamFrameSize)
+  {
+    finishFrame();
+  }
+}
+
+void StreamDecoder::finishAxis()
+{
+  // An axis that ended early has already been reported, its block is dropped
+  // rather than passed on with missing samples
+  for (const auto &axis : block_)
+  {
+    if (axis.size() != config_.blockSize)
+    {
+      blockRange_ = kRangeUnknown;
+      blockTimed_ = false;
+      state_ = TextState::Idle;
+      axis_ = -1;
+      return;
+    }
+  }
+
+  SampleBlock block;
+  block.index = blockIndex_++;
+  block.range = blockRange_;
+  block.timed = blockTimed_;
+  block.startTime = blockStartTime_;
+  block.period = blockPeriod_;
+  block.count = config_.blockSize;
+  for (int axis = 0; axis < 3; axis++)
+  {
+    block.axis[axis] = block_[axis].data();
+  }
+
+  stats_.blocks++;
+  listener_.onBlock(block);
+  blockRange_ = kRangeUnknown;
+  blockTimed_ = false;
+
+  state_ = TextState::Idle;
+  axis_ = -1;
+}
+
+void StreamDecoder::finishFrame()
+{
+  emitFrame(frameSequence_, 0, frame_.data(), frame_.size() / 3);
+  frame_.clear();
+  state_ = TextState::Idle;
+}
+
+void StreamDecoder::emitFrame(uint16_t sequence, uint8_t range, const int16_t *samples, size_t count)
+{
+  SampleFrame frame;
+  frame.sequence = sequence;
+  frame.range = range;
+  frame.count = count;
+  frame.samples = samples;
+
+  stats_.frames++;
+  listener_.onFrame(frame);
+}
+
+void StreamDecoder::error(DecodeError error)
+{
+  stats_.errors++;
+  listener_.onError(error);
+}
+
+} // namespace vibroguard
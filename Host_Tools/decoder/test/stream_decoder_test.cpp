@@ -0,0 +1,356 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Decoder tests
+//
+// Usage: stream_decoder_test
+//
+// Feeds hand-written device output to the decoder and compares what it reports
+// with the known samples, whole and split into chunks of every size. Built
+// twice by CMake, once with the SSE2 and SWAR fast paths and once without
+// (VIBROGUARD_NO_SIMD), and checks the fast number parsing against the scalar
+// reference. Returns 1 if any check fails.
+
+#include "vibroguard/stream_decoder.h"
+#include "number_parser.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace vibroguard;
+
+namespace
+{
+
+int failures = 0;
+
+#define CHECK(condition)                                                                                               \
+  do                                                                                                                   \
+  {                                                                                                                    \
+    if (!(condition))                                                                                                  \
+    {                                                                                                                  \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);                             \
+      failures++;                                                                                                      \
+    }                                                                                                                  \
+  } while (0)
+
+// Writes everything the decoder reports as one line of text per event
+class RecordingListener : public DecoderListener
+{
+public:
+  void onBlock(const SampleBlock &block) override
+  {
+    std::string event = "block " + std::to_string(block.index) + " r" + std::to_string(block.range);
+    if (block.timed)
+    {
+      event += " t" + std::to_string(block.startTime) + "," + std::to_string(block.period);
+    }
+    for (int axis = 0; axis < 3; axis++)
+    {
+      event += ' ';
+      event += static_cast<char>('x' + axis);
+      event += '=';
+      appendValues(event, block.axis[axis], block.count);
+    }
+    events.push_back(event);
+  }
+
+  void onFrame(const SampleFrame &frame) override
+  {
+    std::string event = "frame s" + std::to_string(frame.sequence) + " r" + std::to_string(frame.range) + " ";
+    appendValues(event, frame.samples, 3 * frame.count);
+    events.push_back(event);
+  }
+
+  void onTelemetry(const Telemetry &telemetry) override
+  {
+    events.push_back("telemetry " + std::to_string(telemetry.uptime) + " " + std::to_string(telemetry.staticRam) +
+                     " " + std::to_string(telemetry.freeRam) + " " + std::to_string(telemetry.stackUnused));
+  }
+
+  void onResponse(std::string_view line) override { events.push_back("response " + std::string(line)); }
+
+  void onError(DecodeError error) override { events.push_back("error " + std::to_string(static_cast<int>(error))); }
+
+  std::vector<std::string> events;
+
+private:
+  static void appendValues(std::string &event, const int16_t *values, size_t count)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      event += (i ? "," : "") + std::to_string(values[i]);
+    }
+  }
+};
+
+std::string errorEvent(DecodeError error)
+{
+  return "error " + std::to_string(static_cast<int>(error));
+}
+
+// Builds a binary frame with a valid CRC
+std::string binaryFrame(uint8_t type, const std::vector<uint8_t> &payload)
+{
+  std::vector<uint8_t> bytes = {kFrameSync0, kFrameSync1, type, static_cast<uint8_t>(payload.size())};
+  bytes.insert(bytes.end(), payload.begin(), payload.end());
+  uint16_t crc = crc16(bytes.data() + 2, bytes.size() - 2);
+  bytes.push_back(static_cast<uint8_t>(crc));
+  bytes.push_back(static_cast<uint8_t>(crc >> 8));
+  return std::string(bytes.begin(), bytes.end());
+}
+
+// Small block and frame sizes keep the known samples readable
+DecoderConfig testConfig()
+{
+  DecoderConfig config;
+  config.blockSize = 2;
+  config.streamFrameSize = 2;
+  config.maxLineLength = 24;
+  return config;
+}
+
+std::vector<std::string> decode(const std::string &input, size_t chunk)
+{
+  RecordingListener listener;
+  StreamDecoder decoder(listener, testConfig());
+  for (size_t offset = 0; offset < input.size(); offset += chunk)
+  {
+    decoder.feed(input.data() + offset, std::min(chunk, input.size() - offset));
+  }
+  return listener.events;
+}
+
+// Decodes the input in one piece and in chunks of every size, each must give
+// the expected events
+void checkDecode(const char *name, const std::string &input, const std::vector<std::string> &expected)
+{
+  for (size_t chunk = input.size(); chunk >= 1; chunk--)
+  {
+    std::vector<std::string> events = decode(input, chunk);
+    if (events != expected)
+    {
+      std::fprintf(stderr, "%s: unexpected events with %zu byte chunks:\n", name, chunk);
+      for (const std::string &event : events)
+      {
+        std::fprintf(stderr, "  %s\n", event.c_str());
+      }
+      failures++;
+      return;
+    }
+  }
+}
+
+// A block, a text stream frame, a binary samples frame, a telemetry frame and
+// a command response, as the firmware sends them
+void testKnownFrames()
+{
+  std::string input = "r4\n"
+                      "t1000,5000000\n"
+                      "x\n0.50\n-0.25\n"
+                      "y\n1.00\n-1.00\n"
+                      "z\n0.01\n-2.00\n"
+                      "s7\n"
+                      "0.10,0.20,0.30\r\n"
+                      "-0.10,-0.20,-0.30\n";
+  // Range 0: raw 0, 255, 128 and 64 are -2.00, 2.00, 0.01 and -1.00 g
+  input += binaryFrame(kFrameTypeSamples, {0x34, 0x12, 0x00, 0, 255, 128, 64, 0, 255});
+  // Range 3: raw 0 and 255 are -16.00 and 16.00 g
+  input += binaryFrame(kFrameTypeSamples, {0x35, 0x12, 0x03, 0, 255, 0});
+  input += binaryFrame(kFrameTypeTelemetry, {0x10, 0x27, 0, 0, 0x20, 0x03, 0x00, 0x02, 0x80, 0x00});
+  input += "OK RATE 200\n";
+
+  checkDecode("known frames", input,
+              {"block 0 r1 t1000,5000000 x=50,-25 y=100,-100 z=1,-200",
+               "frame s7 r0 10,20,30,-10,-20,-30",
+               "frame s4660 r0 -200,200,1,-100,-200,200",
+               "frame s4661 r3 -1600,1600,-1600",
+               "telemetry 10000 800 512 128",
+               "response OK RATE 200"});
+}
+
+// A frame with a wrong CRC is reported and skipped as a whole, the next one is
+// decoded
+void testBadCrc()
+{
+  std::string corrupted = binaryFrame(kFrameTypeSamples, {0x01, 0x00, 0x00, 0, 255, 128});
+  corrupted[6] ^= 0x10; // A payload byte
+  std::string input = corrupted + binaryFrame(kFrameTypeSamples, {0x02, 0x00, 0x00, 255, 0, 128});
+
+  checkDecode("bad crc", input, {errorEvent(DecodeError::BadCrc), "frame s2 r0 200,-200,1"});
+
+  std::string badCrcField = binaryFrame(kFrameTypeSamples, {0x03, 0x00, 0x00, 0, 0, 0});
+  badCrcField.back() ^= 0x01;
+  checkDecode("bad crc field", badCrcField + "OK STOP\n", {errorEvent(DecodeError::BadCrc), "response OK STOP"});
+}
+
+// Line noise, a stray sync byte and an over-long line are reported once each
+// and decoding picks up again at the next line or frame
+void testResync()
+{
+  std::string input = "#%&\n";                                           // Unexpected line
+  input += std::string("\xA5\x00", 2);                                   // Sync byte without its partner
+  input += "\n";                                                         // Ends the line the 0x00 started
+  input += "0123456789abcdefghijklmnopqrstuvwxyz\n";                     // Longer than maxLineLength
+  input += "s9\n0.01,0.02,0.03\n0.04,0.05,0.06\n";                      // Valid frame after the garbage
+  input += binaryFrame(kFrameTypeSamples, {0x0A, 0x00, 0x00, 255, 255, 255});
+
+  std::vector<std::string> events = decode(input, input.size());
+  CHECK(events.size() == 6);
+  if (events.size() == 6)
+  {
+    CHECK(events[0] == errorEvent(DecodeError::UnexpectedLine));
+    CHECK(events[1] == errorEvent(DecodeError::BadFrame));
+    CHECK(events[4] == "frame s9 r0 1,2,3,4,5,6");
+    CHECK(events[5] == "frame s10 r0 200,200,200");
+  }
+
+  // However the garbage is split, the valid data after it is decoded
+  for (size_t chunk = 1; chunk <= input.size(); chunk++)
+  {
+    std::vector<std::string> split = decode(input, chunk);
+    CHECK(split.size() >= 2);
+    if (split.size() >= 2)
+    {
+      CHECK(split[split.size() - 2] == "frame s9 r0 1,2,3,4,5,6");
+      CHECK(split.back() == "frame s10 r0 200,200,200");
+    }
+  }
+
+  // A block with a short axis is reported and dropped, the next one is decoded
+  checkDecode("short block", "x\n0.01\ny\n0.02\n0.03\nz\n0.04\n0.05\nx\n0.10\n0.20\ny\n0.30\n0.40\nz\n0.50\n0.60\n",
+              {errorEvent(DecodeError::ShortBlock), "block 0 r255 x=10,20 y=30,40 z=50,60"});
+}
+
+// Command responses are far longer than sample lines. They are decoded
+// however they are split, including into two pieces at every byte, and the
+// data after them is not lost.
+void testLongResponses()
+{
+  std::string tasks = "OK TASKS span=1000000";
+  for (const char *task : {"SAMPLE", "SEND", "COMMAND", "ALERT", "TELEMETRY"})
+  {
+    tasks += std::string(" task=") + task + " runs=4294967295 avg=4294967295 max=4294967295 load=1000";
+  }
+  std::string trace = "OK TRACE entries=16";
+  for (int i = 0; i < 16; i++)
+  {
+    trace += " at=" + std::to_string(4 * 1000 * i) + " addr=104 reg=59 dir=1 len=6 st=0 dur=" + std::to_string(4 * 180);
+  }
+  trace += " busy=11520 span=60720";
+  std::string error = "ERR TRACE " + std::string(100, 'x');
+  CHECK(tasks.size() > 300 && trace.size() > 800); // Far past maxLineLength
+
+  std::string input = tasks + "\n" + trace + "\n" + error + "\n" + "s9\n0.01,0.02,0.03\n0.04,0.05,0.06\n";
+  std::vector<std::string> expected = {"response " + tasks, "response " + trace, "response " + error,
+                                       "frame s9 r0 1,2,3,4,5,6"};
+  checkDecode("long responses", input, expected);
+
+  for (size_t split = 1; split < input.size(); split++)
+  {
+    RecordingListener listener;
+    StreamDecoder decoder(listener, testConfig());
+    decoder.feed(input.data(), split);
+    decoder.feed(input.data() + split, input.size() - split);
+    if (listener.events != expected)
+    {
+      std::fprintf(stderr, "long responses: unexpected events when split at byte %zu\n", split);
+      failures++;
+      break;
+    }
+  }
+}
+
+// The SWAR number parser must agree with the scalar reference, and the SSE2
+// newline search with a plain loop, for every value and alignment
+void testFastPaths()
+{
+  char text[16];
+  for (int32_t centi = -99999; centi <= 99999; centi++)
+  {
+    int32_t magnitude = centi < 0 ? -centi : centi;
+    int length = std::snprintf(text, sizeof(text), "%s%d.%02d", centi < 0 ? "-" : "", magnitude / 100, magnitude % 100);
+
+    int16_t fast = 0, scalar = 0;
+    bool fastValid = parseCenti(text, length, &fast);
+    bool scalarValid = parseCentiScalar(text, length, &scalar);
+    CHECK(fastValid == scalarValid);
+    CHECK(fast == scalar);
+    CHECK(fastValid == (centi >= INT16_MIN && centi <= INT16_MAX));
+    if (fastValid && fast != centi)
+    {
+      std::fprintf(stderr, "parsed %s as %d\n", text, fast);
+      failures++;
+    }
+  }
+
+  const char *malformed[] = {"", "-", ".", "1.", "1.2x", "--1.00", "1.00.", "a.bc", "12345.67", "1,00", " 1.00"};
+  for (const char *line : malformed)
+  {
+    int16_t fast = 0, scalar = 0;
+    bool fastValid = parseCenti(line, std::strlen(line), &fast);
+    bool scalarValid = parseCentiScalar(line, std::strlen(line), &scalar);
+    CHECK(fastValid == scalarValid);
+    CHECK(!fastValid || fast == scalar);
+  }
+
+  char buffer[64];
+  for (size_t length = 0; length <= 48; length++)
+  {
+    for (size_t newline = 0; newline <= length; newline++)
+    {
+      for (size_t offset = 0; offset < 16; offset++)
+      {
+        std::memset(buffer, 'a', sizeof(buffer));
+        if (newline < length)
+        {
+          buffer[offset + newline] = '\n';
+        }
+        const char *begin = buffer + offset;
+        CHECK(findNewline(begin, begin + length) == begin + newline);
+      }
+    }
+  }
+}
+
+} // namespace
+
+int main()
+{
+  testKnownFrames();
+  testBadCrc();
+  testResync();
+  testLongResponses();
+  testFastPaths();
+
+  if (failures)
+  {
+    std::printf("%d checks failed\n", failures);
+    return 1;
+  }
+  std::printf("all checks passed\n");
+  return 0;
+}
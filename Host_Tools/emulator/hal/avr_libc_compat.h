@@ -0,0 +1,48 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Differences between avr-libc and the host C library that the firmware relies
+// on. This header is force-included ahead of every firmware source.
+
+#ifndef HAL_AVR_LIBC_COMPAT_H
+#define HAL_AVR_LIBC_COMPAT_H
+
+#include <cmath>
+#include <math.h>
+
+// avr-libc's modf() skips storing the integral part when iptr is NULL, glibc
+// writes through it. double is 32 bits wide on the AVR, so work in float.
+inline float avr_modf(float x, float *iptr)
+{
+  float integral;
+  float fraction = std::modf(x, &integral);
+  if (iptr)
+  {
+    *iptr = integral;
+  }
+  return fraction;
+}
+#define modf avr_modf
+
+#endif
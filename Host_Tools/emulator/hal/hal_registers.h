@@ -0,0 +1,107 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Register proxies used in place of the memory-mapped AVR registers when the
+// firmware is built for the host. Every access goes through the HAL so that
+// peripherals can react to it and pending interrupts get serviced.
+
+#ifndef VIBROGUARD_HAL_REGISTERS_H
+#define VIBROGUARD_HAL_REGISTERS_H
+
+#include <stdint.h>
+
+namespace hal
+{
+
+enum RegisterId
+{
+  REG_TWBR, REG_TWSR, REG_TWAR, REG_TWDR, REG_TWCR,
+  REG_UDR0, REG_UCSR0A, REG_UCSR0B, REG_UCSR0C, REG_UBRR0H, REG_UBRR0L,
+  REG_TCCR0A, REG_TCCR0B, REG_TCNT0, REG_OCR0A, REG_OCR0B, REG_TIMSK0, REG_TIFR0,
+  REG_TCCR1A, REG_TCCR1B, REG_TCCR1C, REG_TIMSK1, REG_TIFR1,
+  REG_TCCR2A, REG_TCCR2B, REG_TCNT2, REG_OCR2A, REG_OCR2B, REG_TIMSK2, REG_TIFR2,
+  REG_PINB, REG_DDRB, REG_PORTB, REG_PINC, REG_DDRC, REG_PORTC, REG_PIND, REG_DDRD, REG_PORTD,
+  REG_ADMUX, REG_ADCSRA, REG_ADCSRB, REG_ADCL, REG_ADCH, REG_DIDR0,
+  REG_SPCR, REG_SPSR, REG_SPDR,
+  REG_SREG, REG_MCUSR, REG_WDTCSR,
+  REGISTER_COUNT
+};
+
+enum Register16Id
+{
+  REG_TCNT1, REG_OCR1A, REG_OCR1B, REG_ICR1, REG_ADC, REG_SP,
+  REGISTER16_COUNT
+};
+
+uint8_t read(RegisterId id);
+void write(RegisterId id, uint8_t value);
+uint16_t read16(Register16Id id);
+void write16(Register16Id id, uint16_t value);
+
+// Busy wait of the firmware (_delay_us/_delay_ms)
+void delayMicroseconds(double microseconds);
+
+class Register8
+{
+public:
+  explicit Register8(RegisterId id) : id_(id) {}
+
+  operator uint8_t() const { return read(id_); }
+  Register8 &operator=(uint8_t value)
+  {
+    write(id_, value);
+    return *this;
+  }
+  Register8 &operator=(const Register8 &other) { return *this = static_cast<uint8_t>(other); }
+  Register8 &operator|=(uint8_t value) { return *this = static_cast<uint8_t>(read(id_) | value); }
+  Register8 &operator&=(uint8_t value) { return *this = static_cast<uint8_t>(read(id_) & value); }
+  Register8 &operator^=(uint8_t value) { return *this = static_cast<uint8_t>(read(id_) ^ value); }
+
+private:
+  RegisterId id_;
+};
+
+class Register16
+{
+public:
+  explicit Register16(Register16Id id) : id_(id) {}
+
+  operator uint16_t() const { return read16(id_); }
+  Register16 &operator=(uint16_t value)
+  {
+    write16(id_, value);
+    return *this;
+  }
+  Register16 &operator=(const Register16 &other) { return *this = static_cast<uint16_t>(other); }
+  Register16 &operator|=(uint16_t value) { return *this = static_cast<uint16_t>(read16(id_) | value); }
+  Register16 &operator&=(uint16_t value) { return *this = static_cast<uint16_t>(read16(id_) & value); }
+  Register16 &operator+=(uint16_t value) { return *this = static_cast<uint16_t>(read16(id_) + value); }
+
+private:
+  Register16Id id_;
+};
+
+} // namespace hal
+
+#endif
@@ -0,0 +1,405 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Virtual VibroGuard devices on pseudo-terminals
+//
+// Runs the unmodified firmware (main.cpp, Accelerometer, I2C, UART, command
+// protocol) against the host HAL. Every device is a separate process with its
+// own PTY, a simulated MPU6050 and optional fault injection, so host ingest can
+// be load tested with any number of boards.
+
+#include "hal.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/wait.h>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+// The firmware's main(), renamed when it is built for the host
+int firmware_main(void);
+
+namespace
+{
+
+struct Device
+{
+  int master = -1;
+  int slave = -1;
+  std::string path;
+  std::string link;
+  pid_t pid = -1;
+};
+
+std::vector<Device> devices;
+volatile sig_atomic_t stopping = 0;
+
+void usage(const char *program)
+{
+  std::fprintf(stderr,
+               "Usage: %s [options]\n"
+               "  --devices N          number of emulated devices (default 1)\n"
+               "  --link PATH          symlink to the PTY (PATH0, PATH1, ... with several devices)\n"
+               "  --rate HZ            send \"RATE HZ\" at power-up\n"
+               "  --command LINE       send LINE at power-up (repeatable)\n"
+               "  --tone AXIS:HZ:G     add a sine on axis x, y, z or all (repeatable)\n"
+               "  --waveform FILE:HZ   play x y z lines in g from FILE at HZ samples/s\n"
+               "  --gravity G          static acceleration on z (default 1.0)\n"
+               "  --noise G            white noise standard deviation (default 0.02)\n"
+               "  --unthrottled        do not pace the UART at its baud rate\n"
+               "  --drop P             probability of losing a transmitted byte\n"
+               "  --corrupt P          probability of flipping a bit of a transmitted byte\n"
+               "  --i2c-nack P         probability of the sensor not acknowledging\n"
+               "  --i2c-stall P        probability of a TWI operation hanging\n"
+               "  --seed N             random seed (device i uses N + i)\n"
+               "  --verbose            log alert output changes\n",
+               program);
+}
+
+bool parseTone(const char *text, std::vector<hal::Tone> &tones)
+{
+  char axis[8];
+  double frequency, amplitude;
+  if (std::sscanf(text, "%7[^:]:%lf:%lf", axis, &frequency, &amplitude) != 3)
+  {
+    return false;
+  }
+
+  std::string name(axis);
+  for (int i = 0; i < 3; i++)
+  {
+    if (name == "all" || (name.size() == 1 && name[0] == 'x' + i))
+    {
+      tones.push_back({i, frequency, amplitude});
+    }
+  }
+  return name == "all" || name == "x" || name == "y" || name == "z";
+}
+
+bool openPty(Device &device)
+{
+  device.master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (device.master < 0 || grantpt(device.master) != 0 || unlockpt(device.master) != 0)
+  {
+    return false;
+  }
+  device.path = ptsname(device.master);
+
+  // Keep the slave side open so the master never sees a hangup, and make it
+  // raw so the host sees exactly the bytes the firmware sends
+  device.slave = open(device.path.c_str(), O_RDWR | O_NOCTTY);
+  if (device.slave < 0)
+  {
+    return false;
+  }
+  termios settings;
+  tcgetattr(device.slave, &settings);
+  cfmakeraw(&settings);
+  cfsetspeed(&settings, B115200);
+  tcsetattr(device.slave, TCSANOW, &settings);
+
+  fcntl(device.master, F_SETFL, fcntl(device.master, F_GETFL) | O_NONBLOCK);
+  return true;
+}
+
+void printStats(int index)
+{
+  const hal::DeviceStats &stats = hal::stats();
+  char text[256];
+  int length = std::snprintf(text, sizeof(text),
+                             "device %d: sent %llu bytes, dropped %llu, %llu I2C transactions, "
+                             "%llu SPI transactions, %llu ADC conversions, %llu faults injected, %llu late timer periods\n",
+                             index, static_cast<unsigned long long>(stats.bytesSent),
+                             static_cast<unsigned long long>(stats.bytesDropped),
+                             static_cast<unsigned long long>(stats.i2cTransactions),
+                             static_cast<unsigned long long>(stats.spiTransactions),
+                             static_cast<unsigned long long>(stats.adcConversions),
+                             static_cast<unsigned long long>(stats.faultsInjected),
+                             static_cast<unsigned long long>(stats.interruptsLate));
+  if (length > 0)
+  {
+    ssize_t ignored = write(STDERR_FILENO, text, length);
+    (void)ignored;
+  }
+}
+
+int deviceIndex = 0;
+
+void deviceSignal(int)
+{
+  hal::flush();
+  printStats(deviceIndex);
+  _exit(0);
+}
+
+void parentSignal(int)
+{
+  stopping = 1;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  int count = 1;
+  std::string link;
+  hal::DeviceConfig config;
+  bool customWaveform = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    std::string option = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    bool needsValue = option != "--unthrottled" && option != "--verbose" && option != "--help";
+
+    if (needsValue && value == nullptr)
+    {
+      usage(argv[0]);
+      return 2;
+    }
+
+    if (option == "--devices")
+    {
+      count = std::atoi(value);
+    }
+    else if (option == "--link")
+    {
+      link = value;
+    }
+    else if (option == "--rate")
+    {
+      config.bootCommands.push_back(std::string("RATE ") + value);
+    }
+    else if (option == "--command")
+    {
+      config.bootCommands.push_back(value);
+    }
+    else if (option == "--tone")
+    {
+      if (!parseTone(value, config.waveform.tones))
+      {
+        std::fprintf(stderr, "invalid tone %s\n", value);
+        return 2;
+      }
+      customWaveform = true;
+    }
+    else if (option == "--waveform")
+    {
+      const char *rate = std::strrchr(value, ':');
+      config.waveform.recordingRate = rate ? std::atof(rate + 1) : 0;
+      if (config.waveform.recordingRate <= 0 ||
+          !hal::loadRecording(std::string(value, rate - value), config.waveform))
+      {
+        std::fprintf(stderr, "invalid waveform %s\n", value);
+        return 2;
+      }
+      customWaveform = true;
+    }
+    else if (option == "--gravity")
+    {
+      config.waveform.gravity = std::atof(value);
+    }
+    else if (option == "--noise")
+    {
+      config.waveform.noise = std::atof(value);
+    }
+    else if (option == "--drop")
+    {
+      config.faults.dropByte = std::atof(value);
+    }
+    else if (option == "--corrupt")
+    {
+      config.faults.corruptByte = std::atof(value);
+    }
+    else if (option == "--i2c-nack")
+    {
+      config.faults.i2cNack = std::atof(value);
+    }
+    else if (option == "--i2c-stall")
+    {
+      config.faults.i2cStall = std::atof(value);
+    }
+    else if (option == "--seed")
+    {
+      config.seed = std::strtoul(value, nullptr, 10);
+    }
+    else if (option == "--unthrottled")
+    {
+      config.throttleUart = false;
+      continue;
+    }
+    else if (option == "--verbose")
+    {
+      config.verbose = true;
+      continue;
+    }
+    else
+    {
+      usage(argv[0]);
+      return option == "--help" ? 0 : 2;
+    }
+    i++;
+  }
+
+  if (count < 1)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (!customWaveform)
+  {
+    // A motor running at 1500 rpm with a bearing tone
+    config.waveform.tones.push_back({0, 25.0, 0.5});
+    config.waveform.tones.push_back({1, 25.0, 0.3});
+    config.waveform.tones.push_back({2, 25.0, 0.2});
+    config.waveform.tones.push_back({0, 87.0, 0.1});
+  }
+
+  devices.resize(count);
+  for (int i = 0; i < count; i++)
+  {
+    if (!openPty(devices[i]))
+    {
+      std::perror("pseudo-terminal");
+      return 1;
+    }
+  }
+
+  for (int i = 0; i < count; i++)
+  {
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+      std::perror("fork");
+      stopping = 1;
+      break;
+    }
+
+    if (pid == 0)
+    {
+      // Keep only this device's PTY
+      for (int j = 0; j < count; j++)
+      {
+        if (j != i)
+        {
+          close(devices[j].master);
+          close(devices[j].slave);
+        }
+      }
+
+      deviceIndex = i;
+      std::signal(SIGTERM, deviceSignal);
+      std::signal(SIGINT, SIG_IGN);
+
+      config.uartFd = devices[i].master;
+      config.index = i;
+      config.seed += i;
+      hal::powerUp(config);
+
+      return firmware_main();
+    }
+
+    devices[i].pid = pid;
+  }
+
+  // Without SA_RESTART so that wait() returns when interrupted
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = parentSignal;
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  for (int i = 0; i < count; i++)
+  {
+    if (!link.empty())
+    {
+      devices[i].link = (count == 1) ? link : link + std::to_string(i);
+      unlink(devices[i].link.c_str());
+      if (symlink(devices[i].path.c_str(), devices[i].link.c_str()) != 0)
+      {
+        std::perror(devices[i].link.c_str());
+        devices[i].link.clear();
+      }
+    }
+    std::printf("device %d: %s%s%s\n", i, devices[i].path.c_str(), devices[i].link.empty() ? "" : " -> ",
+                devices[i].link.c_str());
+  }
+  std::fflush(stdout);
+
+  // Run until interrupted or until a device exits
+  int remaining = 0;
+  for (const Device &device : devices)
+  {
+    remaining += (device.pid > 0);
+  }
+  while (!stopping && remaining > 0)
+  {
+    int status;
+    pid_t pid = wait(&status);
+    if (pid > 0)
+    {
+      remaining--;
+      if (WIFSIGNALED(status))
+      {
+        std::fprintf(stderr, "device process %d killed by signal %d\n", static_cast<int>(pid), WTERMSIG(status));
+      }
+      else
+      {
+        std::fprintf(stderr, "device process %d exited with status %d\n", static_cast<int>(pid), WEXITSTATUS(status));
+      }
+    }
+    else if (errno != EINTR)
+    {
+      break;
+    }
+  }
+
+  for (Device &device : devices)
+  {
+    if (device.pid > 0)
+    {
+      kill(device.pid, SIGTERM);
+    }
+  }
+  while (wait(nullptr) > 0 || errno == EINTR)
+  {
+  }
+
+  for (const Device &device : devices)
+  {
+    if (!device.link.empty())
+    {
+      unlink(device.link.c_str());
+    }
+  }
+  return 0;
+}
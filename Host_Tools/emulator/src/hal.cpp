@@ -0,0 +1,1108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Host HAL: a cycle-approximate model of the ATmega328P peripherals the
+// firmware uses, running in real time on a device clock derived from
+// CLOCK_MONOTONIC.
+//
+// Everything runs on the firmware's own thread. Interrupts are serviced
+// whenever the firmware touches a register, enables interrupts or waits on a
+// peripheral, which is how an ISR preempts the main loop on the real MCU.
+// Register reads that the firmware would spin on (TWINT, UDRE0) sleep until
+// the peripheral is ready instead of burning host CPU.
+//
+// The device clock stops while the host does not run the firmware: a jump of
+// more than kMaxClockStep between two readings is the thread being preempted,
+// and only kMaxClockStep of it is passed on. A sleep may overrun by up to
+// kMaxSleepOvershoot as long as no bus operation is in flight, so that the
+// clock keeps up with CLOCK_MONOTONIC while the firmware is idle. Bus
+// and timer deadlines are kept on this clock, so a descheduled emulator sees
+// late samples at worst, never a TWI transfer that outlasted its time out.
+
+#include "hal.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <time.h>
+#include <unistd.h>
+
+// Interrupt vectors defined by the firmware
+extern "C" {
+void TIMER0_COMPA_vect(void) __attribute__((weak));
+void TIMER1_OVF_vect(void) __attribute__((weak));
+void TWI_vect(void) __attribute__((weak));
+void ADC_vect(void) __attribute__((weak));
+}
+
+hal::Register8 TWBR(hal::REG_TWBR), TWSR(hal::REG_TWSR), TWAR(hal::REG_TWAR), TWDR(hal::REG_TWDR),
+    TWCR(hal::REG_TWCR);
+hal::Register8 UDR0(hal::REG_UDR0), UCSR0A(hal::REG_UCSR0A), UCSR0B(hal::REG_UCSR0B), UCSR0C(hal::REG_UCSR0C),
+    UBRR0H(hal::REG_UBRR0H), UBRR0L(hal::REG_UBRR0L);
+hal::Register8 TCCR0A(hal::REG_TCCR0A), TCCR0B(hal::REG_TCCR0B), TCNT0(hal::REG_TCNT0), OCR0A(hal::REG_OCR0A),
+    OCR0B(hal::REG_OCR0B), TIMSK0(hal::REG_TIMSK0), TIFR0(hal::REG_TIFR0);
+hal::Register8 TCCR1A(hal::REG_TCCR1A), TCCR1B(hal::REG_TCCR1B), TCCR1C(hal::REG_TCCR1C), TIMSK1(hal::REG_TIMSK1),
+    TIFR1(hal::REG_TIFR1);
+hal::Register8 TCCR2A(hal::REG_TCCR2A), TCCR2B(hal::REG_TCCR2B), TCNT2(hal::REG_TCNT2), OCR2A(hal::REG_OCR2A),
+    OCR2B(hal::REG_OCR2B), TIMSK2(hal::REG_TIMSK2), TIFR2(hal::REG_TIFR2);
+hal::Register8 PINB(hal::REG_PINB), DDRB(hal::REG_DDRB), PORTB(hal::REG_PORTB), PINC(hal::REG_PINC),
+    DDRC(hal::REG_DDRC), PORTC(hal::REG_PORTC), PIND(hal::REG_PIND), DDRD(hal::REG_DDRD), PORTD(hal::REG_PORTD);
+hal::Register8 ADMUX(hal::REG_ADMUX), ADCSRA(hal::REG_ADCSRA), ADCSRB(hal::REG_ADCSRB), ADCL(hal::REG_ADCL),
+    ADCH(hal::REG_ADCH), DIDR0(hal::REG_DIDR0);
+hal::Register8 SPCR(hal::REG_SPCR), SPSR(hal::REG_SPSR), SPDR(hal::REG_SPDR);
+hal::Register8 SREG(hal::REG_SREG), MCUSR(hal::REG_MCUSR), WDTCSR(hal::REG_WDTCSR);
+hal::Register16 TCNT1(hal::REG_TCNT1), OCR1A(hal::REG_OCR1A), OCR1B(hal::REG_OCR1B), ICR1(hal::REG_ICR1),
+    ADC(hal::REG_ADC), SP(hal::REG_SP);
+
+namespace hal
+{
+
+namespace
+{
+
+const double kCpuFrequency = 16000000.0;
+const uint64_t kNever = UINT64_MAX;
+const uint64_t kFlushInterval = 2000000; // ns
+const size_t kFlushSize = 512;
+const uint64_t kMaxClockStep = 100000;      // ns
+const uint64_t kMaxSleepOvershoot = 1000000; // ns, nanosleep() is often 100 µs late
+
+// TWI status codes
+const uint8_t kTwStart = 0x08;
+const uint8_t kTwRepeatedStart = 0x10;
+const uint8_t kTwMtSlaAck = 0x18;
+const uint8_t kTwMtSlaNack = 0x20;
+const uint8_t kTwMtDataAck = 0x28;
+const uint8_t kTwMrSlaAck = 0x40;
+const uint8_t kTwMrSlaNack = 0x48;
+const uint8_t kTwMrDataAck = 0x50;
+const uint8_t kTwMrDataNack = 0x58;
+const uint8_t kTwNoState = 0xF8;
+
+enum TwiState
+{
+  TWI_IDLE,
+  TWI_ADDRESS,  // START sent, next byte is SLA+R/W
+  TWI_TRANSMIT, // Master transmitter, addressed slave acknowledged
+  TWI_RECEIVE,  // Master receiver, addressed slave acknowledged
+  TWI_NOT_ACKED // Addressed slave did not answer
+};
+
+struct Mcu
+{
+  DeviceConfig config;
+  DeviceStats stats;
+
+  uint8_t registers[REGISTER_COUNT];
+  uint16_t registers16[REGISTER16_COUNT];
+
+  bool interruptsEnabled = false;
+  bool inInterrupt = false;
+  uint64_t bootTime = 0;
+
+  // Device clock
+  uint64_t clockLag = 0;      // Host time the firmware did not run, in ns
+  uint64_t lastNow = 0;       // Device time of the last reading
+  uint64_t sleepingUntil = 0; // Device time sleepUntil() waits for
+
+  // Timer0 (CTC on OCR0A)
+  uint64_t timer0Period = 0;
+  uint64_t timer0Deadline = kNever;
+
+  // Timer1 (normal mode, overflow interrupt)
+  uint64_t timer1Deadline = kNever;
+  bool inTimer1Interrupt = false;
+  bool timer1Reloaded = false;
+
+  // ADC
+  uint64_t adcDoneAt = kNever;
+  double adcSampledAt = 0; // Device time the sample and hold captured the input
+  bool adcFirstConversion = true;
+
+  // TWI
+  TwiState twiState = TWI_IDLE;
+  bool twiInterruptFlag = false;
+  bool twiPointerSet = false;
+  uint8_t twiStatus = kTwNoState;
+  uint8_t twiPendingStatus = kTwNoState;
+  uint64_t twiDoneAt = kNever;
+  uint64_t twiStopAt = kNever;
+
+  // A slave that was cut off in the middle of a byte holds SDA low until it
+  // has seen enough SCL pulses to finish it
+  bool sdaHeld = false;
+  int sdaHeldPulses = 0;
+  bool sclLevel = true;
+
+  // SPI, the sensor is selected by PORTB2 (SS)
+  bool spiSelected = false;
+  bool spiCommandSent = false; // The register address byte has been received
+  bool spiReading = false;
+  bool spiInterruptFlag = false;
+  uint8_t spiReceived = 0;
+  uint64_t spiDoneAt = kNever;
+
+  // USART0
+  std::deque<uint8_t> rx;
+  std::vector<uint8_t> tx;
+  uint64_t txReadyAt = 0;
+  uint64_t lastFlush = 0;
+  uint64_t lastRxPoll = 0;
+
+  Mpu6050Model sensor;
+  std::mt19937 random;
+} mcu;
+
+// A TWI, SPI or ADC operation is waiting for its completion time
+bool busPending()
+{
+  return mcu.twiDoneAt != kNever || mcu.twiStopAt != kNever || mcu.spiDoneAt != kNever || mcu.adcDoneAt != kNever;
+}
+
+uint64_t hostTime()
+{
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000ULL + time.tv_nsec;
+}
+
+uint64_t prescaler(uint8_t clockSelect)
+{
+  static const uint64_t values[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+  return values[clockSelect & 0x07];
+}
+
+uint64_t ticksToNs(uint64_t ticks, uint64_t divider)
+{
+  return static_cast<uint64_t>(ticks * divider * 1e9 / kCpuFrequency);
+}
+
+bool chance(double probability)
+{
+  if (probability <= 0)
+  {
+    return false;
+  }
+  std::uniform_real_distribution<double> distribution(0, 1);
+  return distribution(mcu.random) < probability;
+}
+
+void runInterrupt(void (*vector)(void))
+{
+  if (vector == nullptr)
+  {
+    return;
+  }
+  mcu.inInterrupt = true;
+  vector();
+  mcu.inInterrupt = false;
+}
+
+double deviceTime()
+{
+  return (now() - mcu.bootTime) / 1e9;
+}
+
+//////////////// Timers ////////////////
+
+bool timer0Enabled()
+{
+  return (mcu.registers[REG_TIMSK0] & _BV(OCIE0A)) && prescaler(mcu.registers[REG_TCCR0B]);
+}
+
+void restartTimer0()
+{
+  mcu.timer0Period = ticksToNs(mcu.registers[REG_OCR0A] + 1, prescaler(mcu.registers[REG_TCCR0B]));
+  mcu.timer0Deadline = mcu.timer0Period ? now() + mcu.timer0Period : kNever;
+}
+
+uint8_t timer0Count()
+{
+  uint64_t divider = prescaler(mcu.registers[REG_TCCR0B]);
+  if (!divider || mcu.timer0Deadline == kNever || mcu.timer0Period == 0)
+  {
+    return mcu.registers[REG_TCNT0];
+  }
+
+  uint64_t time = now();
+  uint64_t periodStart = mcu.timer0Deadline - mcu.timer0Period;
+  uint64_t elapsed = (time > periodStart) ? time - periodStart : 0;
+  uint64_t ticks = static_cast<uint64_t>(elapsed * kCpuFrequency / 1e9 / divider);
+  // The counter keeps wrapping while the compare interrupt is held off
+  return static_cast<uint8_t>(ticks % (mcu.registers[REG_OCR0A] + 1u));
+}
+
+uint8_t timer0Flags()
+{
+  uint8_t flags = mcu.registers[REG_TIFR0] & ~_BV(OCF0A);
+  if (timer0Enabled() && now() >= mcu.timer0Deadline)
+  {
+    flags |= _BV(OCF0A); // Compare match waiting for its interrupt
+  }
+  return flags;
+}
+
+bool timer1Enabled()
+{
+  return (mcu.registers[REG_TIMSK1] & _BV(TOIE1)) && prescaler(mcu.registers[REG_TCCR1B]);
+}
+
+// Clear timer on compare match with OCR1A
+bool timer1Ctc()
+{
+  return (mcu.registers[REG_TCCR1B] & (_BV(WGM13) | _BV(WGM12))) == _BV(WGM12);
+}
+
+// Compare match B starts ADC conversions (auto trigger source 5)
+bool timer1TriggersAdc()
+{
+  uint8_t adcsra = mcu.registers[REG_ADCSRA];
+  return timer1Ctc() && prescaler(mcu.registers[REG_TCCR1B]) && (adcsra & _BV(ADEN)) && (adcsra & _BV(ADATE)) &&
+         (mcu.registers[REG_ADCSRB] & 0x07) == 5;
+}
+
+uint64_t timer1Period(uint16_t start)
+{
+  return ticksToNs(65536 - start, prescaler(mcu.registers[REG_TCCR1B]));
+}
+
+void restartTimer1(uint64_t from)
+{
+  uint64_t period = timer1Ctc() ? ticksToNs(mcu.registers16[REG_OCR1A] + 1u, prescaler(mcu.registers[REG_TCCR1B]))
+                                : timer1Period(mcu.registers16[REG_TCNT1]);
+  mcu.timer1Deadline = period ? from + period : kNever;
+}
+
+//////////////// ADC ////////////////
+
+uint64_t adcClockTime()
+{
+  if (mcu.config.instantBuses)
+  {
+    return 0;
+  }
+  uint8_t divider = 1 << (mcu.registers[REG_ADCSRA] & 0x07);
+  return static_cast<uint64_t>(1e9 * std::max<uint8_t>(divider, 2) / kCpuFrequency);
+}
+
+void startConversion()
+{
+  if (!(mcu.registers[REG_ADCSRA] & _BV(ADEN)) || mcu.adcDoneAt != kNever)
+  {
+    return;
+  }
+
+  // The first conversion after enabling the ADC initializes the analog circuitry
+  unsigned cycles = mcu.adcFirstConversion ? 25 : 13;
+  mcu.adcFirstConversion = false;
+  mcu.adcSampledAt = deviceTime();
+  mcu.adcDoneAt = now() + cycles * adcClockTime();
+}
+
+// Channels 0 to 2 are wired to the x, y and z outputs of an analog
+// accelerometer centred on AVcc / 2, the others read AVcc / 2
+void completeConversion()
+{
+  if (mcu.adcDoneAt == kNever || now() < mcu.adcDoneAt)
+  {
+    return;
+  }
+  mcu.adcDoneAt = kNever;
+
+  int channel = mcu.registers[REG_ADMUX] & 0x0F;
+  double g = (channel < 3) ? mcu.sensor.acceleration(channel, mcu.adcSampledAt) : 0.0;
+  double scale = mcu.config.analogFullScale;
+  int value = static_cast<int>(std::lround((std::max(-scale, std::min(scale, g)) / scale + 1) / 2 * 1023));
+
+  if (mcu.registers[REG_ADMUX] & _BV(ADLAR))
+  {
+    mcu.registers[REG_ADCH] = value >> 2;
+    mcu.registers[REG_ADCL] = (value & 0x03) << 6;
+  }
+  else
+  {
+    mcu.registers[REG_ADCH] = value >> 8;
+    mcu.registers[REG_ADCL] = value & 0xFF;
+  }
+  mcu.registers[REG_ADCSRA] |= _BV(ADIF);
+  mcu.stats.adcConversions++;
+}
+
+void writeAdcsra(uint8_t value)
+{
+  uint8_t flags = mcu.registers[REG_ADCSRA] & _BV(ADIF);
+  if (value & _BV(ADIF))
+  {
+    flags = 0; // Cleared by writing one
+  }
+  if (!(value & _BV(ADEN)))
+  {
+    mcu.adcDoneAt = kNever;
+    mcu.adcFirstConversion = true;
+  }
+
+  mcu.registers[REG_ADCSRA] = (value & ~(_BV(ADIF) | _BV(ADSC))) | flags;
+  if (value & _BV(ADSC))
+  {
+    startConversion();
+  }
+}
+
+uint8_t readAdcsra()
+{
+  completeConversion();
+  return mcu.registers[REG_ADCSRA] | (mcu.adcDoneAt != kNever ? _BV(ADSC) : 0);
+}
+
+//////////////// USART0 ////////////////
+
+uint64_t uartByteTime()
+{
+  if (!mcu.config.throttleUart)
+  {
+    return 0;
+  }
+  uint16_t ubrr = (mcu.registers[REG_UBRR0H] << 8) | mcu.registers[REG_UBRR0L];
+  double divider = (mcu.registers[REG_UCSR0A] & _BV(U2X0)) ? 8.0 : 16.0;
+  double baud = kCpuFrequency / (divider * (ubrr + 1));
+  return static_cast<uint64_t>(10 * 1e9 / baud); // Start bit, 8 data bits, stop bit
+}
+
+void flushTx()
+{
+  size_t offset = 0;
+  while (offset < mcu.tx.size() && mcu.config.uartFd >= 0)
+  {
+    ssize_t written = ::write(mcu.config.uartFd, mcu.tx.data() + offset, mcu.tx.size() - offset);
+    if (written < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      break; // Nobody is reading the PTY, the bytes are lost like on a real line
+    }
+    offset += written;
+  }
+
+  mcu.stats.bytesDropped += mcu.tx.size() - offset;
+  mcu.tx.clear();
+  mcu.lastFlush = now();
+}
+
+void transmit(uint8_t data)
+{
+  uint64_t time = now();
+  mcu.txReadyAt = std::max(mcu.txReadyAt, time) + uartByteTime();
+
+  if (chance(mcu.config.faults.dropByte))
+  {
+    mcu.stats.faultsInjected++;
+    mcu.stats.bytesDropped++;
+    return;
+  }
+  if (chance(mcu.config.faults.corruptByte))
+  {
+    mcu.stats.faultsInjected++;
+    data ^= static_cast<uint8_t>(1 << (mcu.random() % 8));
+  }
+
+  mcu.tx.push_back(data);
+  mcu.stats.bytesSent++;
+  if (mcu.tx.size() >= kFlushSize)
+  {
+    flushTx();
+  }
+}
+
+void pollRx()
+{
+  uint64_t time = now();
+  if (!mcu.rx.empty() || mcu.config.uartFd < 0 || time - mcu.lastRxPoll < 100000)
+  {
+    return;
+  }
+  mcu.lastRxPoll = time;
+
+  uint8_t buffer[64];
+  ssize_t received = ::read(mcu.config.uartFd, buffer, sizeof(buffer));
+  if (received > 0)
+  {
+    mcu.rx.insert(mcu.rx.end(), buffer, buffer + received);
+  }
+}
+
+uint8_t readUcsr0a()
+{
+  if (mcu.txReadyAt > now())
+  {
+    sleepUntil(mcu.txReadyAt); // The firmware would spin on UDRE0 meanwhile
+  }
+  pollRx();
+
+  uint8_t value = mcu.registers[REG_UCSR0A] & _BV(U2X0);
+  value |= _BV(UDRE0) | _BV(TXC0);
+  if (!mcu.rx.empty())
+  {
+    value |= _BV(RXC0);
+  }
+  return value;
+}
+
+uint8_t receive()
+{
+  pollRx();
+  if (mcu.rx.empty())
+  {
+    return 0;
+  }
+  uint8_t data = mcu.rx.front();
+  mcu.rx.pop_front();
+  return data;
+}
+
+//////////////// TWI ////////////////
+
+uint64_t twiBitTime()
+{
+  if (mcu.config.instantBuses)
+  {
+    return 0;
+  }
+  uint8_t prescale = 1 << (2 * (mcu.registers[REG_TWSR] & 0x03));
+  double scl = kCpuFrequency / (16.0 + 2.0 * mcu.registers[REG_TWBR] * prescale);
+  return static_cast<uint64_t>(1e9 / scl);
+}
+
+void scheduleTwi(uint8_t status, unsigned bits)
+{
+  mcu.twiPendingStatus = status;
+  mcu.twiDoneAt = now() + bits * twiBitTime();
+
+  if (chance(mcu.config.faults.i2cStall))
+  {
+    mcu.stats.faultsInjected++;
+    mcu.twiDoneAt = kNever; // Slave holds the bus until it is clocked free
+    mcu.sdaHeld = true;
+    mcu.sdaHeldPulses = std::uniform_int_distribution<int>(1, 9)(mcu.random);
+  }
+}
+
+void completeTwi()
+{
+  if (mcu.twiDoneAt != kNever && now() >= mcu.twiDoneAt)
+  {
+    mcu.twiDoneAt = kNever;
+    mcu.twiStatus = mcu.twiPendingStatus;
+    mcu.twiInterruptFlag = true;
+  }
+  if (mcu.twiStopAt != kNever && now() >= mcu.twiStopAt)
+  {
+    mcu.twiStopAt = kNever;
+    mcu.registers[REG_TWCR] &= ~_BV(TWSTO);
+  }
+}
+
+void writeTwcr(uint8_t value)
+{
+  if (!(value & _BV(TWEN)))
+  {
+    // Disabling the TWI aborts whatever it was doing
+    mcu.registers[REG_TWCR] = value & ~_BV(TWINT);
+    mcu.twiState = TWI_IDLE;
+    mcu.twiInterruptFlag = false;
+    mcu.twiDoneAt = kNever;
+    mcu.twiStopAt = kNever;
+    mcu.twiStatus = kTwNoState;
+    return;
+  }
+
+  mcu.registers[REG_TWCR] = value & ~_BV(TWINT);
+  if (!(value & _BV(TWINT)))
+  {
+    return; // Only control bits changed
+  }
+
+  // Writing one to TWINT clears the flag and starts the next bus operation
+  mcu.twiInterruptFlag = false;
+
+  if (value & _BV(TWSTA))
+  {
+    if (value & _BV(TWSTO))
+    {
+      // STOP followed by START
+      mcu.twiState = TWI_IDLE;
+      mcu.twiStopAt = now() + twiBitTime();
+    }
+    scheduleTwi(mcu.twiState == TWI_IDLE ? kTwStart : kTwRepeatedStart, (value & _BV(TWSTO)) ? 2 : 1);
+    if (mcu.sdaHeld)
+    {
+      mcu.twiDoneAt = kNever; // No START while SDA is low
+    }
+    mcu.twiState = TWI_ADDRESS;
+    mcu.stats.i2cTransactions++;
+    return;
+  }
+
+  if (value & _BV(TWSTO))
+  {
+    mcu.twiState = TWI_IDLE;
+    mcu.twiStopAt = now() + twiBitTime();
+    mcu.twiStatus = kTwNoState;
+    return;
+  }
+
+  uint8_t data = mcu.registers[REG_TWDR];
+  switch (mcu.twiState)
+  {
+  case TWI_ADDRESS:
+  {
+    bool read = data & 0x01;
+    bool acknowledged = (data >> 1) == Mpu6050Model::kAddress;
+    if (acknowledged && chance(mcu.config.faults.i2cNack))
+    {
+      mcu.stats.faultsInjected++;
+      acknowledged = false;
+    }
+
+    if (acknowledged)
+    {
+      mcu.twiState = read ? TWI_RECEIVE : TWI_TRANSMIT;
+      mcu.twiPointerSet = false;
+      scheduleTwi(read ? kTwMrSlaAck : kTwMtSlaAck, 9);
+    }
+    else
+    {
+      mcu.twiState = TWI_NOT_ACKED;
+      scheduleTwi(read ? kTwMrSlaNack : kTwMtSlaNack, 9);
+    }
+    break;
+  }
+  case TWI_TRANSMIT:
+    if (!mcu.twiPointerSet)
+    {
+      mcu.sensor.setPointer(data);
+      mcu.twiPointerSet = true;
+    }
+    else
+    {
+      mcu.sensor.writeNext(data);
+    }
+    scheduleTwi(kTwMtDataAck, 9);
+    break;
+  case TWI_RECEIVE:
+    mcu.registers[REG_TWDR] = mcu.sensor.readNext(deviceTime());
+    scheduleTwi((value & _BV(TWEA)) ? kTwMrDataAck : kTwMrDataNack, 9);
+    break;
+  default:
+    scheduleTwi(kTwNoState, 9);
+    break;
+  }
+}
+
+// Level of an open-drain line on port C: low when driven low or held by the slave
+bool portCLine(uint8_t bit)
+{
+  bool driven = (mcu.registers[REG_DDRC] & _BV(bit)) && !(mcu.registers[REG_PORTC] & _BV(bit));
+  return !driven && !(bit == PORTC4 && mcu.sdaHeld);
+}
+
+// Bit-banged SCL pulses (bus recovery) release a held SDA line
+void writePortc(RegisterId id, uint8_t value)
+{
+  mcu.registers[id] = value;
+
+  bool scl = portCLine(PORTC5);
+  if (scl && !mcu.sclLevel && mcu.sdaHeld && --mcu.sdaHeldPulses == 0)
+  {
+    mcu.sdaHeld = false;
+  }
+  mcu.sclLevel = scl;
+}
+
+uint8_t readPinc()
+{
+  uint8_t pins = mcu.registers[REG_PINC] & ~(_BV(PORTC4) | _BV(PORTC5));
+  pins |= portCLine(PORTC4) ? _BV(PORTC4) : 0;
+  pins |= portCLine(PORTC5) ? _BV(PORTC5) : 0;
+  return pins;
+}
+
+uint8_t readTwcr()
+{
+  completeTwi();
+
+  // The firmware polls TWINT and TWSTO, sleep until the bus operation is done
+  bool interruptDriven = mcu.registers[REG_TWCR] & _BV(TWIE);
+  if (!interruptDriven && !mcu.twiInterruptFlag)
+  {
+    uint64_t until = std::min(mcu.twiDoneAt, mcu.twiStopAt);
+    if (until != kNever)
+    {
+      sleepUntil(until);
+      completeTwi();
+    }
+    else if (mcu.twiState != TWI_IDLE)
+    {
+      sleepUntil(now() + 100000); // Stalled bus, let the firmware's timeout run
+    }
+  }
+
+  return mcu.registers[REG_TWCR] | (mcu.twiInterruptFlag ? _BV(TWINT) : 0);
+}
+
+//////////////// SPI ////////////////
+
+uint64_t spiBitTime()
+{
+  if (mcu.config.instantBuses)
+  {
+    return 0;
+  }
+  static const double dividers[4] = {4, 16, 64, 128};
+  double divider = dividers[mcu.registers[REG_SPCR] & 0x03];
+  if (mcu.registers[REG_SPSR] & _BV(SPI2X))
+  {
+    divider /= 2;
+  }
+  return static_cast<uint64_t>(1e9 * divider / kCpuFrequency);
+}
+
+// A byte written to SPDR is shifted out while the selected sensor shifts out
+// its answer. The sensor takes the first byte after being selected as the
+// register address, bit 7 set for reads, like the MPU-6000.
+void writeSpdr(uint8_t value)
+{
+  if (!(mcu.registers[REG_SPCR] & _BV(SPE)))
+  {
+    return;
+  }
+
+  uint8_t answer = 0xFF; // MISO floats high when no slave is selected
+  if (mcu.spiSelected)
+  {
+    if (!mcu.spiCommandSent)
+    {
+      mcu.spiCommandSent = true;
+      mcu.spiReading = value & 0x80;
+      mcu.sensor.setPointer(value & 0x7F);
+      mcu.stats.spiTransactions++;
+      answer = 0;
+    }
+    else if (mcu.spiReading)
+    {
+      answer = mcu.sensor.readNext(deviceTime());
+    }
+    else
+    {
+      mcu.sensor.writeNext(value);
+      answer = 0;
+    }
+  }
+
+  mcu.spiReceived = answer;
+  mcu.spiInterruptFlag = false;
+  mcu.spiDoneAt = now() + 8 * spiBitTime();
+}
+
+uint8_t readSpsr()
+{
+  // The firmware polls SPIF, sleep until the byte is done
+  if (mcu.spiDoneAt != kNever)
+  {
+    sleepUntil(mcu.spiDoneAt);
+    mcu.spiDoneAt = kNever;
+    mcu.spiInterruptFlag = true;
+  }
+  return mcu.registers[REG_SPSR] | (mcu.spiInterruptFlag ? _BV(SPIF) : 0);
+}
+
+uint8_t readSpdr()
+{
+  mcu.spiInterruptFlag = false;
+  return mcu.spiReceived;
+}
+
+//////////////// GPIO ////////////////
+
+void writePortb(uint8_t value)
+{
+  uint8_t changed = mcu.registers[REG_PORTB] ^ value;
+  mcu.registers[REG_PORTB] = value;
+
+  // Selecting the sensor starts a new transfer
+  bool selected = (mcu.registers[REG_DDRB] & _BV(PORTB2)) && !(value & _BV(PORTB2));
+  if (selected && !mcu.spiSelected)
+  {
+    mcu.spiCommandSent = false;
+  }
+  mcu.spiSelected = selected;
+
+  if ((changed & _BV(PORTB0)) && mcu.config.verbose)
+  {
+    // The alert output is active low
+    std::fprintf(stderr, "device %d: %.3f s alert %s\n", mcu.config.index, deviceTime(),
+                 (value & _BV(PORTB0)) ? "off" : "on");
+  }
+}
+
+//////////////// Interrupts ////////////////
+
+void service()
+{
+  if (mcu.inInterrupt)
+  {
+    return;
+  }
+
+  uint64_t time = now();
+  if (!mcu.tx.empty() && time - mcu.lastFlush >= kFlushInterval)
+  {
+    flushTx();
+  }
+
+  if (!mcu.interruptsEnabled)
+  {
+    return;
+  }
+
+  if (timer0Enabled() && time >= mcu.timer0Deadline)
+  {
+    // Catch up on missed compare matches so that millis stays accurate
+    unsigned runs = 0;
+    while (time >= mcu.timer0Deadline && runs++ < 64)
+    {
+      mcu.timer0Deadline += mcu.timer0Period;
+      runInterrupt(TIMER0_COMPA_vect);
+    }
+    if (time >= mcu.timer0Deadline)
+    {
+      uint64_t missed = (time - mcu.timer0Deadline) / mcu.timer0Period + 1;
+      mcu.stats.interruptsLate += missed;
+      mcu.timer0Deadline += missed * mcu.timer0Period;
+    }
+  }
+
+  if (timer1Enabled() && time >= mcu.timer1Deadline)
+  {
+    uint64_t deadline = mcu.timer1Deadline;
+
+    mcu.inTimer1Interrupt = true;
+    mcu.timer1Reloaded = false;
+    mcu.registers16[REG_TCNT1] = 0;
+    runInterrupt(TIMER1_OVF_vect);
+    mcu.inTimer1Interrupt = false;
+
+    if (!mcu.timer1Reloaded)
+    {
+      restartTimer1(deadline);
+    }
+    if (mcu.timer1Deadline != kNever && time >= mcu.timer1Deadline)
+    {
+      // The host fell more than a sample period behind, drop the backlog
+      uint64_t period = mcu.timer1Deadline - deadline;
+      uint64_t missed = (time - mcu.timer1Deadline) / period + 1;
+      mcu.stats.interruptsLate += missed;
+      mcu.timer1Deadline += missed * period;
+    }
+  }
+
+  if (timer1TriggersAdc() && time >= mcu.timer1Deadline)
+  {
+    uint64_t period = ticksToNs(mcu.registers16[REG_OCR1A] + 1u, prescaler(mcu.registers[REG_TCCR1B]));
+    uint64_t missed = (time - mcu.timer1Deadline) / period;
+    mcu.stats.interruptsLate += missed;
+    mcu.timer1Deadline += (missed + 1) * period;
+
+    // The ADC starts on the rising edge of OCF1B, which the firmware has to clear
+    if (!(mcu.registers[REG_TIFR1] & _BV(OCF1B)))
+    {
+      mcu.registers[REG_TIFR1] |= _BV(OCF1B);
+      startConversion();
+    }
+  }
+
+  completeConversion();
+  if ((mcu.registers[REG_ADCSRA] & (_BV(ADIE) | _BV(ADIF))) == (_BV(ADIE) | _BV(ADIF)))
+  {
+    mcu.registers[REG_ADCSRA] &= ~_BV(ADIF); // Cleared when the vector runs
+    runInterrupt(ADC_vect);
+  }
+
+  completeTwi();
+  if ((mcu.registers[REG_TWCR] & (_BV(TWIE) | _BV(TWEN))) == (_BV(TWIE) | _BV(TWEN)) && mcu.twiInterruptFlag)
+  {
+    runInterrupt(TWI_vect);
+  }
+}
+
+} // namespace
+
+//////////////// Register access ////////////////
+
+uint8_t read(RegisterId id)
+{
+  service();
+
+  switch (id)
+  {
+  case REG_TWCR:
+    return readTwcr();
+  case REG_TWSR:
+    completeTwi();
+    return mcu.twiStatus | (mcu.registers[REG_TWSR] & 0x03);
+  case REG_UCSR0A:
+    return readUcsr0a();
+  case REG_UDR0:
+    return receive();
+  case REG_TCNT0:
+    return timer0Count();
+  case REG_TIFR0:
+    return timer0Flags();
+  case REG_PINC:
+    return readPinc();
+  case REG_SPSR:
+    return readSpsr();
+  case REG_ADCSRA:
+    return readAdcsra();
+  case REG_SPDR:
+    return readSpdr();
+  case REG_SREG:
+    return (mcu.interruptsEnabled && !mcu.inInterrupt) ? 0x80 : 0x00;
+  default:
+    return mcu.registers[id];
+  }
+}
+
+void write(RegisterId id, uint8_t value)
+{
+  switch (id)
+  {
+  case REG_TWCR:
+    writeTwcr(value);
+    break;
+  case REG_TWSR:
+    mcu.registers[REG_TWSR] = value & 0x03; // Only the prescaler bits are writable
+    break;
+  case REG_UDR0:
+    transmit(value);
+    break;
+  case REG_PORTB:
+    writePortb(value);
+    break;
+  case REG_SPDR:
+    writeSpdr(value);
+    break;
+  case REG_SPSR:
+    mcu.registers[REG_SPSR] = value & _BV(SPI2X); // Only SPI2X is writable
+    break;
+  case REG_DDRC:
+  case REG_PORTC:
+    writePortc(id, value);
+    break;
+  case REG_SREG:
+    if (value & 0x80)
+    {
+      enableInterrupts();
+    }
+    else
+    {
+      disableInterrupts();
+    }
+    break;
+  case REG_TCCR0A:
+  case REG_TCCR0B:
+  case REG_OCR0A:
+  case REG_TIMSK0:
+    mcu.registers[id] = value;
+    restartTimer0();
+    break;
+  case REG_TCCR1B:
+    mcu.registers[id] = value;
+    restartTimer1(now());
+    break;
+  case REG_TIFR1:
+    mcu.registers[id] &= ~value; // Flags are cleared by writing one
+    break;
+  case REG_ADCSRA:
+    writeAdcsra(value);
+    break;
+  default:
+    mcu.registers[id] = value;
+    break;
+  }
+
+  service();
+}
+
+uint16_t read16(Register16Id id)
+{
+  service();
+  return mcu.registers16[id];
+}
+
+void write16(Register16Id id, uint16_t value)
+{
+  mcu.registers16[id] = value;
+
+  if (id == REG_TCNT1)
+  {
+    // A reload from the overflow ISR counts from the overflow, not from the
+    // moment the ISR got around to it
+    if (mcu.inTimer1Interrupt)
+    {
+      mcu.timer1Reloaded = true;
+      restartTimer1(mcu.timer1Deadline);
+    }
+    else
+    {
+      restartTimer1(now());
+    }
+  }
+
+  service();
+}
+
+void delayMicroseconds(double microseconds)
+{
+  sleepUntil(now() + static_cast<uint64_t>(microseconds * 1000));
+}
+
+void disableInterrupts()
+{
+  if (!mcu.inInterrupt)
+  {
+    mcu.interruptsEnabled = false;
+  }
+}
+
+void enableInterrupts()
+{
+  if (!mcu.inInterrupt)
+  {
+    mcu.interruptsEnabled = true;
+    service();
+  }
+}
+
+//////////////// Emulator interface ////////////////
+
+uint64_t now()
+{
+  uint64_t time = hostTime() - mcu.clockLag;
+
+  // More than a step past the last reading or the end of a sleep is time the
+  // host spent elsewhere
+  uint64_t overshoot = busPending() ? kMaxClockStep : kMaxSleepOvershoot;
+  uint64_t limit = std::max(mcu.lastNow + kMaxClockStep, mcu.sleepingUntil + overshoot);
+  if (mcu.lastNow && time > limit)
+  {
+    mcu.clockLag += time - limit;
+    time = limit;
+  }
+
+  mcu.lastNow = time;
+  return time;
+}
+
+void sleepUntil(uint64_t time)
+{
+  for (;;)
+  {
+    service();
+
+    uint64_t current = now();
+    if (current >= time)
+    {
+      return;
+    }
+
+    // Wake up for the next timer interrupt and to poll the UART
+    uint64_t wake = std::min(time, current + 1000000);
+    if (mcu.interruptsEnabled && !mcu.inInterrupt)
+    {
+      if (timer0Enabled())
+      {
+        wake = std::min(wake, mcu.timer0Deadline);
+      }
+      if (timer1Enabled() || timer1TriggersAdc())
+      {
+        wake = std::min(wake, mcu.timer1Deadline);
+      }
+      wake = std::min(wake, mcu.adcDoneAt);
+      if (mcu.registers[REG_TWCR] & _BV(TWIE))
+      {
+        wake = std::min(wake, std::min(mcu.twiDoneAt, mcu.twiStopAt));
+      }
+    }
+
+    if (wake > current)
+    {
+      mcu.sleepingUntil = wake;
+      timespec delay;
+      delay.tv_sec = (wake - current) / 1000000000ULL;
+      delay.tv_nsec = (wake - current) % 1000000000ULL;
+      nanosleep(&delay, nullptr);
+    }
+  }
+}
+
+void powerUp(const DeviceConfig &config)
+{
+  mcu.config = config;
+  std::memset(mcu.registers, 0, sizeof(mcu.registers));
+  std::memset(mcu.registers16, 0, sizeof(mcu.registers16));
+  mcu.registers[REG_TWBR] = 0;
+  mcu.registers[REG_UCSR0A] = _BV(UDRE0);
+  mcu.registers16[REG_SP] = RAMEND;
+
+  mcu.bootTime = now();
+  mcu.lastFlush = mcu.bootTime;
+  mcu.random.seed(config.seed);
+  mcu.sensor.configure(config.waveform, config.seed);
+
+  for (const std::string &command : config.bootCommands)
+  {
+    mcu.rx.insert(mcu.rx.end(), command.begin(), command.end());
+    mcu.rx.push_back('\n');
+  }
+}
+
+void flush()
+{
+  flushTx();
+}
+
+const DeviceStats &stats()
+{
+  return mcu.stats;
+}
+
+} // namespace hal
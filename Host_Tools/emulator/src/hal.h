@@ -0,0 +1,89 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Control interface of the host HAL, used by the emulator around the firmware
+
+#ifndef VIBROGUARD_HAL_H
+#define VIBROGUARD_HAL_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mpu6050_model.h"
+
+namespace hal
+{
+
+struct FaultConfig
+{
+  double dropByte = 0;    // Probability that a transmitted byte is lost
+  double corruptByte = 0; // Probability that a transmitted byte has a bit flipped
+  double i2cNack = 0;     // Probability that the sensor NACKs its address
+  double i2cStall = 0;    // Probability that a TWI operation never completes
+};
+
+struct DeviceConfig
+{
+  int uartFd = -1;             // Pseudo-terminal master the UART is attached to
+  bool throttleUart = true;    // Pace transmission at the programmed baud rate
+  bool instantBuses = false;   // Complete TWI, SPI and ADC operations without their bus time
+  bool verbose = false;        // Log alert output changes to stderr
+  int index = 0;               // Device number used in log messages
+  uint32_t seed = 1;
+  FaultConfig faults;
+  WaveformConfig waveform;
+  double analogFullScale = 16.0; // g at 0 V and AVcc of the analog inputs (ANALOG_RANGE)
+  std::vector<std::string> bootCommands; // Lines queued on the UART at power-up
+};
+
+struct DeviceStats
+{
+  uint64_t bytesSent = 0;
+  uint64_t bytesDropped = 0; // Lost to fault injection or a full PTY
+  uint64_t i2cTransactions = 0;
+  uint64_t spiTransactions = 0;
+  uint64_t adcConversions = 0;
+  uint64_t faultsInjected = 0;
+  uint64_t interruptsLate = 0; // Timer periods skipped because the host fell behind
+};
+
+// Prepares the simulated MCU. Must be called once before the firmware runs.
+void powerUp(const DeviceConfig &config);
+
+// Flushes pending UART output
+void flush();
+
+const DeviceStats &stats();
+
+// Sleeps until the given time (nanoseconds on the device clock) while
+// servicing interrupts
+void sleepUntil(uint64_t time);
+// Device clock in nanoseconds: CLOCK_MONOTONIC without the time the host
+// did not run the firmware
+uint64_t now();
+
+} // namespace hal
+
+#endif
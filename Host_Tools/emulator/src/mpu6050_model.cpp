@@ -0,0 +1,194 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "mpu6050_model.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace hal
+{
+
+// MPU6050 registers
+static const uint8_t kRegAccelConfig = 0x1C;
+static const uint8_t kRegAccelXoutH = 0x3B;
+static const uint8_t kRegTempOutH = 0x41;
+static const uint8_t kRegPwrMgmt1 = 0x6B;
+static const uint8_t kRegWhoAmI = 0x75;
+
+Mpu6050Model::Mpu6050Model() : noise_(0.0, 1.0)
+{
+  std::memset(registers_, 0, sizeof(registers_));
+  registers_[kRegPwrMgmt1] = 0x40; // Sleep bit set after power-up
+  registers_[kRegWhoAmI] = kAddress;
+}
+
+void Mpu6050Model::configure(const WaveformConfig &waveform, uint32_t seed)
+{
+  waveform_ = waveform;
+  random_.seed(seed);
+
+  // Give every device its own phases so that emulated boards are not identical
+  std::uniform_real_distribution<double> phase(0, 2 * M_PI);
+  phases_.clear();
+  for (size_t i = 0; i < waveform_.tones.size(); i++)
+  {
+    phases_.push_back(phase(random_));
+  }
+}
+
+bool loadRecording(const std::string &path, WaveformConfig &waveform)
+{
+  std::ifstream file(path);
+  if (!file)
+  {
+    return false;
+  }
+
+  std::vector<std::array<double, 3>> recording;
+  std::string line;
+  while (std::getline(file, line))
+  {
+    size_t start = line.find_first_not_of(" \t\r");
+    if (start == std::string::npos || line[start] == '#')
+    {
+      continue;
+    }
+
+    std::array<double, 3> sample;
+    if (std::sscanf(line.c_str(), "%lf%*[ ,\t]%lf%*[ ,\t]%lf", &sample[0], &sample[1], &sample[2]) != 3)
+    {
+      return false;
+    }
+    recording.push_back(sample);
+  }
+
+  if (recording.empty())
+  {
+    return false;
+  }
+  waveform.recording.swap(recording);
+  return true;
+}
+
+double Mpu6050Model::acceleration(int axis, double time)
+{
+  if (!waveform_.recording.empty())
+  {
+    return played(axis, time);
+  }
+
+  double g = (axis == 2) ? waveform_.gravity : 0.0;
+
+  for (size_t i = 0; i < waveform_.tones.size(); i++)
+  {
+    const Tone &tone = waveform_.tones[i];
+    if (tone.axis == axis)
+    {
+      g += tone.amplitude * std::sin(2 * M_PI * tone.frequency * time + phases_[i]);
+    }
+  }
+
+  if (waveform_.noise > 0)
+  {
+    g += waveform_.noise * noise_(random_);
+  }
+  return g;
+}
+
+// Interpolates the recording linearly at the given time
+double Mpu6050Model::played(int axis, double time)
+{
+  const std::vector<std::array<double, 3>> &recording = waveform_.recording;
+  double position = std::fmod(time * waveform_.recordingRate, static_cast<double>(recording.size()));
+  size_t index = static_cast<size_t>(position);
+  double fraction = position - index;
+
+  double g = recording[index][axis] * (1 - fraction) + recording[(index + 1) % recording.size()][axis] * fraction;
+  if (waveform_.noise > 0)
+  {
+    g += waveform_.noise * noise_(random_);
+  }
+  return g;
+}
+
+// Samples all axes into the output registers, like the sensor does when a
+// burst read starts at ACCEL_XOUT_H
+void Mpu6050Model::latchSample(double time)
+{
+  bool sleeping = registers_[kRegPwrMgmt1] & 0x40;
+  double lsbPerG = 16384.0 / (1 << ((registers_[kRegAccelConfig] >> 3) & 0x03));
+
+  for (int axis = 0; axis < 3; axis++)
+  {
+    long raw = sleeping ? 0 : std::lround(acceleration(axis, time) * lsbPerG);
+    if (raw > INT16_MAX)
+    {
+      raw = INT16_MAX; // The sensor saturates outside its range
+    }
+    if (raw < INT16_MIN)
+    {
+      raw = INT16_MIN;
+    }
+    registers_[kRegAccelXoutH + 2 * axis] = static_cast<uint8_t>(static_cast<uint16_t>(raw) >> 8);
+    registers_[kRegAccelXoutH + 2 * axis + 1] = static_cast<uint8_t>(raw);
+  }
+
+  // 25 degrees Celsius
+  int16_t temperature = static_cast<int16_t>((25.0 - 36.53) * 340);
+  registers_[kRegTempOutH] = static_cast<uint8_t>(static_cast<uint16_t>(temperature) >> 8);
+  registers_[kRegTempOutH + 1] = static_cast<uint8_t>(temperature);
+}
+
+uint8_t Mpu6050Model::readNext(double time)
+{
+  if (pointer_ == kRegAccelXoutH)
+  {
+    latchSample(time);
+  }
+  uint8_t value = registers_[pointer_ & 0x7F];
+  pointer_++;
+  return value;
+}
+
+void Mpu6050Model::writeNext(uint8_t value)
+{
+  uint8_t reg = pointer_ & 0x7F;
+  if (reg == kRegPwrMgmt1 && (value & 0x80))
+  {
+    // DEVICE_RESET restores the power-up state
+    std::memset(registers_, 0, sizeof(registers_));
+    registers_[kRegPwrMgmt1] = 0x40;
+    registers_[kRegWhoAmI] = kAddress;
+  }
+  else if (reg != kRegWhoAmI)
+  {
+    registers_[reg] = value;
+  }
+  pointer_++;
+}
+
+} // namespace hal
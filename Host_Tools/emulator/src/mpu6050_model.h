@@ -0,0 +1,94 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Register-level model of the MPU6050 as seen from its I2C interface
+
+#ifndef VIBROGUARD_MPU6050_MODEL_H
+#define VIBROGUARD_MPU6050_MODEL_H
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace hal
+{
+
+struct Tone
+{
+  int axis;         // 0 = x, 1 = y, 2 = z
+  double frequency; // Hz
+  double amplitude; // g
+};
+
+struct WaveformConfig
+{
+  std::vector<Tone> tones;
+  double gravity = 1.0; // Static acceleration on z in g
+  double noise = 0.02;  // Standard deviation of white noise in g
+
+  // Recorded x, y, z accelerations in g, played in a loop instead of the
+  // tones and gravity when not empty. Noise is still added.
+  std::vector<std::array<double, 3>> recording;
+  double recordingRate = 0; // Samples per second
+};
+
+// Reads a waveform file into waveform.recording: one sample per line, x y z in
+// g separated by spaces or commas. Empty lines and lines starting with '#' are
+// skipped.
+bool loadRecording(const std::string &path, WaveformConfig &waveform);
+
+class Mpu6050Model
+{
+public:
+  static const uint8_t kAddress = 0x68;
+
+  Mpu6050Model();
+
+  void configure(const WaveformConfig &waveform, uint32_t seed);
+
+  // Register pointer access for the TWI state machine
+  void setPointer(uint8_t reg) { pointer_ = reg; }
+  uint8_t readNext(double time);
+  void writeNext(uint8_t value);
+
+  // Acceleration in g at the given time, before quantization
+  double acceleration(int axis, double time);
+
+private:
+  double played(int axis, double time);
+  void latchSample(double time);
+
+  uint8_t registers_[128];
+  uint8_t pointer_ = 0;
+  WaveformConfig waveform_;
+  std::vector<double> phases_;
+  std::mt19937 random_;
+  std::normal_distribution<double> noise_;
+};
+
+} // namespace hal
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Sample formatting benchmark
+//
+// Usage: format_benchmark [--values N]
+//
+// Checks the firmware's formatting against legacy_floatToString(), a frozen
+// copy of the floatToString() the firmware shipped with, then times it. The
+// check covers every int16 value with two decimals, every raw sample in every
+// range as sendBuffer() formats it and the precomputed sampleStrings of the
+// ±2 g range. fixed_to_string(), the table and the firmware's own
+// floatToString() must all print byte for byte what the original did.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "auxiliary_functions.h"
+#include "fixed_point.h"
+#include "floatToString.h"
+#include "legacy_float_to_string.h"
+#include "sample_strings.h"
+
+namespace
+{
+
+struct Comparison
+{
+  unsigned long checked = 0;
+  unsigned long mismatches = 0;
+};
+
+// Counts a difference between the legacy and the new output
+void compare(Comparison &result, const char *legacy, const char *formatted)
+{
+  result.checked++;
+  if (std::strcmp(legacy, formatted) == 0)
+  {
+    return;
+  }
+
+  if (result.mismatches < 10)
+  {
+    std::printf("mismatch: legacy \"%s\", fixed \"%s\"\n", legacy, formatted);
+  }
+  result.mismatches++;
+}
+
+void report(const char *name, const Comparison &result)
+{
+  std::printf("%-8s %7lu values, %lu mismatches\n", name, result.checked, result.mismatches);
+}
+
+// The firmware's sampleToString(), limit is the full scale in hundredths of a g
+char *formatSample(uint8_t raw, int32_t limit, char *buffer)
+{
+  int32_t centi = RangeMap(0, 255, -limit, limit).mapRounded(raw);
+  if (centi % 100 == 0 && raw != 0 && raw != 255)
+  {
+    return fixed_to_string_carried(centi, 2, buffer);
+  }
+  return fixed_to_string(centi, 2, buffer);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t values = 10000000;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--values") == 0 && i + 1 < argc)
+    {
+      values = std::strtoul(argv[++i], nullptr, 10);
+    }
+  }
+
+  char legacy[TO_STRING_SIZE];
+  char firmware[TO_STRING_SIZE];
+  char formatted[FIXED_STRING_SIZE];
+
+  // The firmware's floatToString() must still be the original
+  Comparison kept;
+
+  Comparison scalar;
+  for (int32_t value = INT16_MIN; value <= INT16_MAX; value++)
+  {
+    legacy_floatToString(value / 100.0f, legacy, sizeof(legacy), 2);
+    compare(scalar, legacy, fixed_to_string(value, 2, formatted));
+    compare(kept, legacy, floatToString(value / 100.0f, firmware, sizeof(firmware), 2));
+  }
+  report("int16", scalar);
+
+  // As the firmware formatted samples before, from the float map_range()
+  Comparison samples;
+  for (int fullScale = 2; fullScale <= 16; fullScale *= 2)
+  {
+    int32_t limit = fullScale * 100;
+    for (int raw = 0; raw < 256; raw++)
+    {
+      float value = map_range(raw, 0, 255, -limit, limit) / 100.0f;
+      legacy_floatToString(value, legacy, sizeof(legacy), 2);
+      compare(samples, legacy, formatSample(raw, limit, formatted));
+      compare(kept, legacy, floatToString(value, firmware, sizeof(firmware), 2));
+    }
+  }
+  report("samples", samples);
+  report("legacy", kept);
+
+  unsigned long tableMismatches = 0;
+  for (int raw = 0; raw < 256; raw++)
+  {
+    legacy_floatToString(map_range(raw, 0, 255, -200, 200) / 100.0f, legacy, sizeof(legacy), 2);
+    if (std::strcmp(sampleStrings[raw], legacy) != 0)
+    {
+      std::printf("table mismatch: %d is \"%s\", legacy \"%s\"\n", raw, sampleStrings[raw], legacy);
+      tableMismatches++;
+    }
+  }
+  std::printf("table    %7d values, %lu mismatches\n", 256, tableMismatches);
+
+  // Time both on the values of a block in the ±2 g range
+  std::vector<float> inputs(256);
+  std::vector<int32_t> fixedInputs(256);
+  for (int raw = 0; raw < 256; raw++)
+  {
+    inputs[raw] = map_range(raw, 0, 255, -200, 200) / 100.0;
+    fixedInputs[raw] = static_cast<int32_t>(map_range(raw, 0, 255, -200, 200) + (raw < 128 ? -0.5f : 0.5f));
+  }
+
+  unsigned long checksum = 0;
+  auto started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < values; i++)
+  {
+    checksum += floatToString(inputs[i & 255], legacy, sizeof(legacy), 2)[1];
+  }
+  double legacyTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < values; i++)
+  {
+    checksum += fixed_to_string(fixedInputs[i & 255], 2, formatted)[1];
+  }
+  double fixedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  started = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < values; i++)
+  {
+    checksum += std::strcpy(formatted, sampleStrings[i & 255])[1];
+  }
+  double tableTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+  std::printf("floatToString:   %.1f ns/value\n", legacyTime * 1e9 / values);
+  std::printf("fixed_to_string: %.1f ns/value (%.1fx)\n", fixedTime * 1e9 / values, legacyTime / fixedTime);
+  std::printf("sampleStrings:   %.1f ns/value (%.1fx)\n", tableTime * 1e9 / values, legacyTime / tableTime);
+  std::printf("checksum %lu\n", checksum);
+
+  return scalar.mismatches || samples.mismatches || kept.mismatches || tableMismatches ? 1 : 0;
+}
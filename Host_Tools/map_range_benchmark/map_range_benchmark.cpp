@@ -0,0 +1,163 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// map_range() benchmark
+//
+// Usage: map_range_benchmark [--calls N]
+//
+// Checks the integer map_range<>() and RangeMap against the float map_range()
+// on every input the firmware maps with them: each 16-bit accelerometer
+// reading in each range, and each raw sample converted to hundredths of a g.
+// Then counts the cycles per call of the three versions on the host (the time
+// stamp counter on x86, nanoseconds elsewhere). Any mismatch fails the run.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "auxiliary_functions.h"
+
+namespace
+{
+
+uint64_t now()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+// Accelerometer::mapAcceleration() before it moved to map_range<>()
+uint8_t legacyAccelerometer(int16_t raw, uint8_t range)
+{
+  const float accScale = 16384.0 / (1 << range);
+  float acceleration = (float)raw / accScale;
+  float limit = (2 << range) * 100;
+  return (uint8_t)map_range(acceleration * 100, -limit, limit, 0, 255);
+}
+
+// sampleToString() before it moved to RangeMap
+int32_t legacySample(uint8_t raw, uint8_t range)
+{
+  float limit = (2 << range) * 100;
+  float value = map_range(raw, 0, 255, -limit, limit);
+  return static_cast<int32_t>(value + (value < 0 ? -0.5f : 0.5f));
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  size_t calls = 10000000;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--calls") == 0 && i + 1 < argc)
+    {
+      calls = std::strtoul(argv[++i], nullptr, 10);
+    }
+  }
+
+  unsigned long accelerometerMismatches = 0;
+  unsigned long sampleMismatches = 0;
+  for (uint8_t range = 0; range < 4; range++)
+  {
+    for (int32_t raw = INT16_MIN; raw <= INT16_MAX; raw++)
+    {
+      uint8_t expected = legacyAccelerometer(raw, range);
+      uint8_t mapped = map_range<-32768, 32768, 0, 255>(raw);
+      if (mapped != expected && accelerometerMismatches++ < 10)
+      {
+        std::printf("accelerometer mismatch: %d in range %d, float %d, fixed %d\n", raw, range, expected, mapped);
+      }
+    }
+
+    int32_t limit = (2 << range) * 100;
+    RangeMap sampleMap(0, 255, -limit, limit);
+    for (int raw = 0; raw < 256; raw++)
+    {
+      int32_t expected = legacySample(raw, range);
+      int32_t mapped = sampleMap.mapRounded(raw);
+      if (mapped != expected && sampleMismatches++ < 10)
+      {
+        std::printf("sample mismatch: %d in range %d, float %d, fixed %d\n", raw, range, expected, mapped);
+      }
+    }
+  }
+  std::printf("accelerometer %7d values, %lu mismatches\n", 4 * 65536, accelerometerMismatches);
+  std::printf("samples       %7d values, %lu mismatches\n", 4 * 256, sampleMismatches);
+
+  // Readings in the ±2 g range, hidden from the optimizer behind a vector
+  std::vector<int32_t> inputs(4096);
+  for (size_t i = 0; i < inputs.size(); i++)
+  {
+    inputs[i] = static_cast<int16_t>(i * 7919);
+  }
+  size_t mask = inputs.size() - 1;
+  volatile float limit = 200;
+  volatile int32_t sink = 0;
+
+  uint64_t started = now();
+  for (size_t i = 0; i < calls; i++)
+  {
+    sink = static_cast<int32_t>(map_range(inputs[i & mask] / 16384.0f * 100, -limit, limit, 0, 255));
+  }
+  double floatCycles = double(now() - started) / calls;
+
+  started = now();
+  for (size_t i = 0; i < calls; i++)
+  {
+    sink = map_range<-32768, 32768, 0, 255>(inputs[i & mask]);
+  }
+  double templateCycles = double(now() - started) / calls;
+
+  RangeMap runtimeMap(-32768, 32768, 0, 255);
+  started = now();
+  for (size_t i = 0; i < calls; i++)
+  {
+    sink = runtimeMap.map(inputs[i & mask]);
+  }
+  double runtimeCycles = double(now() - started) / calls;
+
+#if defined(__x86_64__) || defined(__i386__)
+  const char *unit = "cycles";
+#else
+  const char *unit = "ns";
+#endif
+  std::printf("float map_range:   %6.2f %s/call\n", floatCycles, unit);
+  std::printf("map_range<>:       %6.2f %s/call (%.1fx)\n", templateCycles, unit, floatCycles / templateCycles);
+  std::printf("RangeMap::map:     %6.2f %s/call (%.1fx)\n", runtimeCycles, unit, floatCycles / runtimeCycles);
+  (void)sink;
+
+  return accelerometerMismatches || sampleMismatches ? 1 : 0;
+}
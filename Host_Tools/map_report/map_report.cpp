@@ -0,0 +1,237 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Static RAM report from a GNU ld map file
+//
+// Usage: vibroguard_map_report [--ram BYTES] file.map
+//
+// Lists the .data, .bss and .noinit bytes every object file contributes, as in
+// the Debug/VibroGuard_Final.map that Microchip Studio generates, largest
+// first, and what is left of the RAM (2048 bytes by default) for the stack.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+enum Section
+{
+  kData,
+  kBss,
+  kNoinit,
+  kSectionCount,
+};
+
+const char *const kSectionNames[kSectionCount] = {".data", ".bss", ".noinit"};
+
+struct Module
+{
+  std::string name;
+  unsigned long bytes[kSectionCount] = {};
+
+  unsigned long total() const { return bytes[kData] + bytes[kBss] + bytes[kNoinit]; }
+};
+
+// Object file name without its directory, archive members keep the archive name
+std::string moduleName(const std::string &path)
+{
+  size_t slash = path.find_last_of("/\\");
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+int sectionIndex(const std::string &name)
+{
+  for (int i = 0; i < kSectionCount; i++)
+  {
+    if (name == kSectionNames[i])
+    {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Parses "<address> <size> <file>" of an input section, the file may contain spaces
+bool parsePlacement(const std::string &text, unsigned long *size, std::string *file)
+{
+  std::istringstream fields(text);
+  std::string address, sizeText;
+  if (!(fields >> address >> sizeText) || address.compare(0, 2, "0x") != 0 || sizeText.compare(0, 2, "0x") != 0)
+  {
+    return false;
+  }
+
+  *size = std::strtoul(sizeText.c_str(), nullptr, 16);
+  std::getline(fields >> std::ws, *file);
+  return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  unsigned long ram = 2048; // ATmega328P
+  const char *path = nullptr;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--ram") == 0 && i + 1 < argc)
+    {
+      ram = std::strtoul(argv[++i], nullptr, 10);
+    }
+    else
+    {
+      path = argv[i];
+    }
+  }
+  if (!path)
+  {
+    std::fprintf(stderr, "usage: %s [--ram BYTES] file.map\n", argv[0]);
+    return 1;
+  }
+
+  std::ifstream file(path);
+  if (!file)
+  {
+    std::fprintf(stderr, "cannot open %s\n", path);
+    return 1;
+  }
+
+  std::map<std::string, Module> modules;
+  std::string line;
+  bool memoryMap = false; // Input sections listed before the memory map were discarded
+  int section = -1;       // Output section being listed, or -1 if it isn't in RAM
+  std::string pending;    // Input section whose placement is on the next line
+
+  while (std::getline(file, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+    if (!memoryMap)
+    {
+      memoryMap = line.find("Linker script and memory map") == 0;
+      continue;
+    }
+    if (line.empty())
+    {
+      continue;
+    }
+
+    // Output sections start in the first column
+    if (line[0] != ' ')
+    {
+      section = sectionIndex(line.substr(0, line.find(' ')));
+      pending.clear();
+      continue;
+    }
+    if (section < 0)
+    {
+      continue;
+    }
+
+    unsigned long size;
+    std::string object;
+    if (line.size() > 1 && line[1] != ' ')
+    {
+      // Input section " .bss.name 0x... 0x... file.o", long names wrap before the address
+      std::string name = line.substr(1, line.find(' ', 1) - 1);
+      if (name[0] == '*' && name != "*fill*")
+      {
+        continue; // Linker script pattern such as " *(.data*)"
+      }
+      size_t rest = line.find_first_not_of(' ', 1 + name.size());
+      if (rest == std::string::npos)
+      {
+        pending = name;
+        continue;
+      }
+      if (!parsePlacement(line.substr(rest), &size, &object))
+      {
+        continue;
+      }
+      if (name == "*fill*")
+      {
+        object = "(alignment)";
+      }
+    }
+    else if (!pending.empty() && parsePlacement(line, &size, &object))
+    {
+      pending.clear();
+    }
+    else
+    {
+      continue; // Symbol or assignment
+    }
+
+    if (size == 0)
+    {
+      continue;
+    }
+    Module &module = modules[moduleName(object)];
+    module.name = moduleName(object);
+    module.bytes[section] += size;
+  }
+
+  if (!memoryMap)
+  {
+    std::fprintf(stderr, "%s is not a linker map file\n", path);
+    return 1;
+  }
+
+  std::vector<Module> sorted;
+  Module total;
+  total.name = "total";
+  for (const auto &entry : modules)
+  {
+    sorted.push_back(entry.second);
+    for (int i = 0; i < kSectionCount; i++)
+    {
+      total.bytes[i] += entry.second.bytes[i];
+    }
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Module &a, const Module &b) { return a.total() > b.total(); });
+  sorted.push_back(total);
+
+  std::printf("%-32s %7s %7s %7s %7s\n", "module", ".data", ".bss", ".noinit", "ram");
+  for (const Module &module : sorted)
+  {
+    std::printf("%-32s %7lu %7lu %7lu %7lu\n", module.name.c_str(), module.bytes[kData], module.bytes[kBss],
+                module.bytes[kNoinit], module.total());
+  }
+
+  long left = static_cast<long>(ram) - static_cast<long>(total.total());
+  std::printf("\n%lu of %lu bytes of RAM are static, %ld are left for the stack and heap\n", total.total(), ram, left);
+  return left < 0 ? 2 : 0;
+}
@@ -0,0 +1,56 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Board of pipeline_benchmark, selected with -DBOARD_HEADER. The pins are those
+// of the Nano on the register model. The console writes into a plain variable
+// instead of UDR0, so that the block benchmarks time the formatting of the
+// firmware rather than the model's handling of each UART byte.
+
+#ifndef VIBROGUARD_BENCH_BOARD_H
+#define VIBROGUARD_BENCH_BOARD_H
+
+// Last byte written to the console, defined in pipeline_benchmark.cpp
+extern volatile uint8_t consoleSink;
+
+struct Board
+{
+  BOARD_PIN(Alert, B, 0);
+  BOARD_PIN(Sda, C, 4);
+  BOARD_PIN(Scl, C, 5);
+  BOARD_PIN(SpiSs, B, 2);
+  BOARD_PIN(SpiMosi, B, 3);
+  BOARD_PIN(SpiSck, B, 5);
+  BOARD_PIN(SensorCs, B, 2);
+
+  struct Console
+  {
+    static void begin(uint16_t ubrr) {}
+    static bool readable() { return false; }
+    static bool writable() { return true; }
+    static uint8_t read() { return 0; }
+    static void write(uint8_t data) { consoleSink = data; }
+  };
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Firmware pipeline benchmark
+//
+// Usage: pipeline_benchmark [--waveform FILE:HZ] [--min-time SECONDS] [--filter TEXT]
+//
+// Runs the per-sample and per-block code of the firmware on the register model
+// of the emulator and reports the time per call. The TWI completes without its
+// bus time and the console writes into consoleSink (bench_board.h) instead of
+// the UART model, so the block results are the cost of the firmware's
+// formatting. The sample results still include the register model of the TWI
+// and the timer. The sensor model plays the waveform file if given, or the
+// emulator's default motor tones.
+//
+// Each benchmark runs for at least --min-time (default 0.5 s). For a profile:
+//
+//   perf record -g ./pipeline_benchmark --filter block
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "hal.h"
+
+#include <avr/interrupt.h>
+
+#include "Accelerometer.h"
+#include "sensor_bus.h"
+#include "uart_communication.h"
+
+// Firmware state and functions of main.cpp
+extern Accelerometer accelerometer;
+extern I2CBus sensorBus;
+extern volatile uint8_t transmissionMode;
+extern volatile bool bufferReady;
+extern volatile int bufferIndex;
+void storeReadings(struct accComp readings);
+void sendBuffer();
+extern "C" void TIMER1_OVF_vect(void);
+
+volatile uint8_t consoleSink;
+
+namespace
+{
+
+// TRANSMISSION_MODE_* of main.cpp
+const uint8_t kModeBlock = 0;
+const uint8_t kModeStream = 1;
+
+const int kBlockSamples = 256; // BUFFER_SIZE of main.cpp
+
+double minTime = 0.5;
+std::string filter;
+
+// Calls body with growing iteration counts until a run lasts minTime, then
+// prints the time per iteration and per item
+void run(const char *name, void (*body)(size_t), size_t itemsPerIteration)
+{
+  if (!filter.empty() && std::strstr(name, filter.c_str()) == nullptr)
+  {
+    return;
+  }
+
+  size_t iterations = 1;
+  double elapsed = 0;
+  for (;;)
+  {
+    auto started = std::chrono::steady_clock::now();
+    body(iterations);
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    if (elapsed >= minTime || iterations >= (size_t(1) << 40))
+    {
+      break;
+    }
+    // Aim 40% past the target so the next run is the last one
+    double factor = elapsed > 0 ? minTime * 1.4 / elapsed : 100;
+    iterations = static_cast<size_t>(iterations * (factor < 100 ? (factor > 2 ? factor : 2) : 100));
+  }
+
+  double perIteration = elapsed * 1e9 / iterations;
+  std::printf("%-20s %12.1f ns %12zu %12.1f ns/item %10.0f k items/s\n", name, perIteration, iterations,
+              perIteration / itemsPerIteration, iterations * itemsPerIteration / elapsed / 1e3);
+}
+
+// One byte to the console, the floor of every transmission
+void uartByte(size_t iterations)
+{
+  for (size_t i = 0; i < iterations; i++)
+  {
+    UART_transmit('0');
+  }
+}
+
+// Blocking burst read of the three axes over the TWI, converted to 0-255
+void sampleRead(size_t iterations)
+{
+  for (size_t i = 0; i < iterations; i++)
+  {
+    storeReadings(accelerometer.getAcceleration());
+  }
+}
+
+// The sampling interrupt storing a sample in the stream ring
+void sampleIsr(size_t iterations)
+{
+  transmissionMode = kModeStream;
+  for (size_t i = 0; i < iterations; i++)
+  {
+    TIMER1_OVF_vect();
+  }
+  transmissionMode = kModeBlock;
+}
+
+// Acquires a block from the sensor model in the current range
+void fillBlock()
+{
+  bufferIndex = 0;
+  bufferReady = true;
+  for (int i = 0; i < kBlockSamples; i++)
+  {
+    storeReadings(accelerometer.getAcceleration());
+    TIMER1_OVF_vect();
+  }
+}
+
+// Range tags, time tags and 3 x 256 formatted samples of a full block
+void sendBlock(size_t iterations)
+{
+  for (size_t i = 0; i < iterations; i++)
+  {
+    sendBuffer();
+  }
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  hal::DeviceConfig config;
+  config.throttleUart = false;
+  config.instantBuses = true;
+  bool customWaveform = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (std::strcmp(argv[i], "--waveform") == 0 && i + 1 < argc)
+    {
+      const char *value = argv[++i];
+      const char *rate = std::strrchr(value, ':');
+      config.waveform.recordingRate = rate ? std::atof(rate + 1) : 0;
+      if (config.waveform.recordingRate <= 0 ||
+          !hal::loadRecording(std::string(value, rate - value), config.waveform))
+      {
+        std::fprintf(stderr, "invalid waveform %s\n", value);
+        return 2;
+      }
+      customWaveform = true;
+    }
+    else if (std::strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+    {
+      minTime = std::atof(argv[++i]);
+    }
+    else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+    {
+      filter = argv[++i];
+    }
+    else
+    {
+      std::fprintf(stderr, "Usage: %s [--waveform FILE:HZ] [--min-time SECONDS] [--filter TEXT]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  if (!customWaveform)
+  {
+    // The emulator's default, a motor running at 1500 rpm with a bearing tone
+    config.waveform.tones.push_back({0, 25.0, 0.5});
+    config.waveform.tones.push_back({1, 25.0, 0.3});
+    config.waveform.tones.push_back({2, 25.0, 0.2});
+    config.waveform.tones.push_back({0, 87.0, 0.1});
+  }
+
+  // Only the peripherals under test are started, so no timer interrupt
+  // lands in the measurements
+  hal::powerUp(config);
+  UART_init(115200);
+  sei();
+  accelerometer.begin(sensorBus);
+
+  std::printf("%-20s %15s %12s %20s %20s\n", "Benchmark", "Time", "Iterations", "Per item", "Throughput");
+  run("uart/byte", uartByte, 1);
+  run("sample/read", sampleRead, 1);
+  run("sample/isr", sampleIsr, 1);
+
+  fillBlock();
+  run("block/send_2g", sendBlock, 3 * kBlockSamples);
+
+  accelerometer.setRange(ACC_RANGE_16G);
+  fillBlock();
+  run("block/send_16g", sendBlock, 3 * kBlockSamples);
+
+  hal::flush();
+  return 0;
+}
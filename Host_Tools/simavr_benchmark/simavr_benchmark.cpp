@@ -0,0 +1,760 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2024 Linuka Ratnayake
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+// Cycle-accurate firmware benchmark on simavr
+//
+// Usage: simavr_benchmark [options] firmware.elf
+//
+// Runs the AVR build of the firmware in simavr with an MPU6050 on the TWI and
+// the UART captured, and reports:
+//
+//   - the cycles spent in the sampling interrupt (TIMER1_OVF_vect)
+//   - the worst interrupt latency of any vector, from the flag being raised
+//     to the vector being entered
+//   - the time spent in each sendBuffer() call
+//   - the achieved sample rate: in block mode the samples of the blocks over
+//     the time from the first "t" tag to the last, so the time between blocks
+//     counts, in the other modes the sample counter of STATS over time
+//   - the slowest rate within a block and the longest gap between the last
+//     sample of a block and the first of the next, from the "t" tags
+//   - the samples dropped according to STATS
+//
+// With --thresholds FILE every number is compared to its limit and the exit
+// status is 1 if one is exceeded, so the run can gate a build. A file without
+// limits fails as well. --record FILE writes the results of the run as limits,
+// with --margin percent (default 5) of room.
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include <avr_twi.h>
+#include <avr_uart.h>
+#include <sim_avr.h>
+#include <sim_elf.h>
+#include <sim_interrupts.h>
+#include <sim_irq.h>
+}
+
+#include "mpu6050_model.h"
+
+namespace
+{
+
+const uint32_t kFrequency = 16000000;
+const uint8_t kMpuAddress = 0x68;
+const int kBlockSamples = 256; // BUFFER_SIZE of main.cpp
+
+struct Options
+{
+  std::string elf;
+  std::string mcu;
+  std::string thresholds;
+  std::string record;
+  double margin = 5.0;
+  std::vector<std::string> commands;
+  double seconds = 4.0;
+  int sampleVector = -1; // TIMER1_OVF_vect of the MCU unless given
+};
+
+uint16_t readU16(const std::vector<char> &data, size_t offset)
+{
+  return static_cast<uint16_t>(uint8_t(data[offset]) | uint8_t(data[offset + 1]) << 8);
+}
+
+uint32_t readU32(const std::vector<char> &data, size_t offset)
+{
+  return readU16(data, offset) | static_cast<uint32_t>(readU16(data, offset + 2)) << 16;
+}
+
+// Address of a function in the symbol table of an ELF32 file, 0 if missing
+uint32_t findSymbol(const std::string &path, const char *name)
+{
+  std::ifstream file(path, std::ios::binary);
+  std::vector<char> elf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+  if (elf.size() < 52 || std::memcmp(elf.data(), "\x7f" "ELF", 4) != 0 || elf[4] != 1)
+  {
+    return 0;
+  }
+
+  uint32_t sections = readU32(elf, 32);
+  uint16_t sectionSize = readU16(elf, 46);
+  uint16_t sectionCount = readU16(elf, 48);
+  for (uint16_t i = 0; i < sectionCount; i++)
+  {
+    size_t header = sections + size_t(i) * sectionSize;
+    if (header + 40 > elf.size() || readU32(elf, header + 4) != 2) // SHT_SYMTAB
+    {
+      continue;
+    }
+
+    uint32_t symbols = readU32(elf, header + 16);
+    uint32_t symbolsSize = readU32(elf, header + 20);
+    size_t stringHeader = sections + size_t(readU32(elf, header + 24)) * sectionSize;
+    if (stringHeader + 40 > elf.size())
+    {
+      return 0;
+    }
+    uint32_t strings = readU32(elf, stringHeader + 16);
+    for (uint32_t symbol = symbols; symbol + 16 <= symbols + symbolsSize && symbol + 16 <= elf.size(); symbol += 16)
+    {
+      size_t nameOffset = strings + readU32(elf, symbol);
+      if (nameOffset < elf.size() && std::strcmp(elf.data() + nameOffset, name) == 0)
+      {
+        return readU32(elf, symbol + 4);
+      }
+    }
+  }
+  return 0;
+}
+
+// MPU6050 on the TWI, answering from the emulator's register model
+struct MpuPeer
+{
+  avr_t *avr;
+  avr_irq_t *irq;
+  hal::Mpu6050Model model;
+  bool selected = false;
+  bool pointerNext = false; // The next byte written is the register pointer
+};
+
+void twiMessage(avr_irq_t *, uint32_t value, void *param)
+{
+  MpuPeer *peer = static_cast<MpuPeer *>(param);
+  avr_twi_msg_irq_t message;
+  message.u.v = value;
+
+  if (message.u.twi.msg & TWI_COND_STOP)
+  {
+    peer->selected = false;
+  }
+  if (message.u.twi.msg & TWI_COND_START)
+  {
+    peer->selected = (message.u.twi.addr >> 1) == kMpuAddress;
+    peer->pointerNext = !(message.u.twi.addr & 1);
+    if (peer->selected)
+    {
+      avr_raise_irq(peer->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, message.u.twi.addr, 1));
+    }
+  }
+  if (!peer->selected)
+  {
+    return;
+  }
+
+  if (message.u.twi.msg & TWI_COND_WRITE)
+  {
+    avr_raise_irq(peer->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_ACK, message.u.twi.addr, 1));
+    if (peer->pointerNext)
+    {
+      peer->model.setPointer(message.u.twi.data);
+      peer->pointerNext = false;
+    }
+    else
+    {
+      peer->model.writeNext(message.u.twi.data);
+    }
+  }
+  if (message.u.twi.msg & TWI_COND_READ)
+  {
+    uint8_t data = peer->model.readNext(double(peer->avr->cycle) / kFrequency);
+    avr_raise_irq(peer->irq + TWI_IRQ_INPUT, avr_twi_irq_msg(TWI_COND_READ, message.u.twi.addr, data));
+  }
+}
+
+// A "t" tag: time of the first sample of a block in us, sample period in ns
+struct BlockTag
+{
+  uint32_t start;
+  uint32_t period;
+};
+
+struct Capture
+{
+  avr_t *avr;
+  std::string line;
+  std::vector<BlockTag> tags;
+  std::vector<std::pair<double, std::map<std::string, uint32_t>>> stats; // Time and fields of each STATS reply
+};
+
+void uartOutput(avr_irq_t *, uint32_t value, void *param)
+{
+  Capture *capture = static_cast<Capture *>(param);
+  char c = static_cast<char>(value);
+  if (c != '\n')
+  {
+    if (capture->line.size() < 256)
+    {
+      capture->line += c;
+    }
+    return;
+  }
+
+  const std::string &line = capture->line;
+  unsigned long start, period;
+  if (line[0] == 't' && std::sscanf(line.c_str(), "t%lu,%lu", &start, &period) == 2)
+  {
+    capture->tags.push_back({static_cast<uint32_t>(start), static_cast<uint32_t>(period)});
+  }
+  else if (line.compare(0, 9, "OK STATS ") == 0)
+  {
+    std::map<std::string, uint32_t> fields;
+    size_t position = 9;
+    while (position < line.size())
+    {
+      size_t end = line.find(' ', position);
+      std::string field = line.substr(position, end == std::string::npos ? std::string::npos : end - position);
+      size_t equals = field.find('=');
+      if (equals != std::string::npos)
+      {
+        fields[field.substr(0, equals)] = std::strtoul(field.c_str() + equals + 1, nullptr, 10);
+      }
+      position = (end == std::string::npos) ? line.size() : end + 1;
+    }
+    capture->stats.push_back({double(capture->avr->cycle) / kFrequency, fields});
+  }
+  capture->line.clear();
+}
+
+// Interrupt timing from the PENDING and RUNNING signals of the vectors. simavr
+// raises PENDING for flags the firmware polls as well, only flags raised while
+// their interrupt is enabled count for the latency.
+struct VectorTiming
+{
+  avr_int_vector_t *vector;
+  avr_t *avr;
+  avr_cycle_count_t pendingSince = 0;
+  avr_cycle_count_t clearedAt = 0;  // Pending is cleared as the vector is entered
+  avr_cycle_count_t clearedSince = 0;
+  avr_cycle_count_t enteredAt = 0;
+  uint64_t calls = 0;
+  uint64_t totalCycles = 0;
+  uint64_t worstCycles = 0;
+  uint64_t worstLatency = 0;
+};
+
+void vectorPending(avr_irq_t *, uint32_t value, void *param)
+{
+  VectorTiming *timing = static_cast<VectorTiming *>(param);
+  if (!value)
+  {
+    timing->clearedAt = timing->avr->cycle;
+    timing->clearedSince = timing->pendingSince;
+    timing->pendingSince = 0;
+  }
+  else if (!timing->pendingSince && avr_regbit_get(timing->avr, timing->vector->enable))
+  {
+    timing->pendingSince = timing->avr->cycle;
+  }
+}
+
+void vectorRunning(avr_irq_t *, uint32_t value, void *param)
+{
+  VectorTiming *timing = static_cast<VectorTiming *>(param);
+  avr_cycle_count_t now = timing->avr->cycle;
+  if (value)
+  {
+    avr_cycle_count_t since = timing->pendingSince ? timing->pendingSince
+                              : (timing->clearedAt == now ? timing->clearedSince : 0);
+    timing->enteredAt = now;
+    if (since && now - since > timing->worstLatency)
+    {
+      timing->worstLatency = now - since;
+    }
+    timing->pendingSince = 0;
+    return;
+  }
+
+  uint64_t cycles = now - timing->enteredAt;
+  timing->calls++;
+  timing->totalCycles += cycles;
+  if (cycles > timing->worstCycles)
+  {
+    timing->worstCycles = cycles;
+  }
+}
+
+void sendLine(avr_t *avr, const std::string &line)
+{
+  avr_irq_t *input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+  for (char c : line)
+  {
+    avr_raise_irq(input, static_cast<uint8_t>(c));
+  }
+  avr_raise_irq(input, '\n');
+}
+
+std::map<std::string, double> readThresholds(const std::string &path, bool &ok)
+{
+  std::map<std::string, double> limits;
+  std::ifstream file(path);
+  ok = static_cast<bool>(file);
+  std::string line;
+  while (ok && std::getline(file, line))
+  {
+    char name[64];
+    double value;
+    if (line.empty() || line[0] == '#')
+    {
+      continue;
+    }
+    if (std::sscanf(line.c_str(), "%63s %lf", name, &value) != 2)
+    {
+      ok = false;
+      break;
+    }
+    limits[name] = value;
+  }
+  return limits;
+}
+
+// What each result is, as a comment above its limit in a recorded file
+const char *describe(const std::string &name)
+{
+  static const std::map<std::string, const char *> descriptions = {
+      {"max_isr_cycles", "Cycles of one TIMER1_OVF_vect call, including entry and reti"},
+      {"max_latency_cycles", "Cycles from an enabled interrupt flag being raised to its vector running"},
+      {"max_block_ms", "One sendBuffer() call"},
+      {"min_rate_hz", "Samples stored per second, including the time between blocks"},
+      {"min_block_rate_hz", "Slowest sample rate within a block"},
+      {"max_gap_ms", "Longest time from the last sample of a block to the first of the next"},
+      {"max_dropped", "Samples lost between the two STATS commands"},
+  };
+  auto description = descriptions.find(name);
+  return description == descriptions.end() ? "" : description->second;
+}
+
+// Writes the results as limits, with margin percent of room in the direction
+// of each limit
+bool recordThresholds(const std::string &path, const std::map<std::string, double> &results, const Options &options)
+{
+  FILE *file = std::fopen(path.c_str(), "w");
+  if (file == nullptr)
+  {
+    return false;
+  }
+
+  std::fprintf(file, "# Limits of simavr_benchmark, recorded from %s\n", options.elf.c_str());
+  std::fprintf(file, "# on %s for %.1f s", options.mcu.c_str(), options.seconds);
+  for (const std::string &command : options.commands)
+  {
+    std::fprintf(file, ", \"%s\"", command.c_str());
+  }
+  std::fprintf(file, ", with %.0f%% margin. max_* fail when exceeded, min_* when\n# not reached.\n", options.margin);
+
+  for (const auto &result : results)
+  {
+    const std::string &name = result.first;
+    bool minimum = name.compare(0, 4, "min_") == 0;
+    bool counted = name == "max_dropped" || name.find("_cycles") != std::string::npos;
+    double limit = result.second * (minimum ? 1 - options.margin / 100 : 1 + options.margin / 100);
+    if (counted)
+    {
+      limit = minimum ? std::floor(limit) : std::ceil(limit);
+    }
+    std::fprintf(file, "\n# %s\n%s %.*f\n", describe(name), name.c_str(), counted ? 0 : 2, limit);
+  }
+  return std::fclose(file) == 0;
+}
+
+void usage(const char *program)
+{
+  std::fprintf(stderr,
+               "Usage: %s [options] firmware.elf\n"
+               "  --mcu NAME           simavr core (default from the ELF, else atmega328p)\n"
+               "  --seconds S          simulated time (default 4)\n"
+               "  --command LINE       send LINE after boot (repeatable)\n"
+               "  --vector N           vector number of the sampling interrupt\n"
+               "  --thresholds FILE    fail if a result exceeds its limit in FILE\n"
+               "  --record FILE        write the results as limits to FILE\n"
+               "  --margin PERCENT     room left by --record (default 5)\n",
+               program);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+  Options options;
+  for (int i = 1; i < argc; i++)
+  {
+    std::string option = argv[i];
+    const char *value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+    if (option[0] != '-')
+    {
+      options.elf = option;
+      continue;
+    }
+    if (value == nullptr)
+    {
+      usage(argv[0]);
+      return 2;
+    }
+
+    if (option == "--mcu")
+    {
+      options.mcu = value;
+    }
+    else if (option == "--seconds")
+    {
+      options.seconds = std::atof(value);
+    }
+    else if (option == "--command")
+    {
+      options.commands.push_back(value);
+    }
+    else if (option == "--vector")
+    {
+      options.sampleVector = std::atoi(value);
+    }
+    else if (option == "--thresholds")
+    {
+      options.thresholds = value;
+    }
+    else if (option == "--record")
+    {
+      options.record = value;
+    }
+    else if (option == "--margin")
+    {
+      options.margin = std::atof(value);
+    }
+    else
+    {
+      usage(argv[0]);
+      return 2;
+    }
+    i++;
+  }
+  if (options.elf.empty())
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  std::map<std::string, double> limits;
+  if (!options.thresholds.empty())
+  {
+    bool ok;
+    limits = readThresholds(options.thresholds, ok);
+    if (!ok)
+    {
+      std::fprintf(stderr, "invalid thresholds file %s\n", options.thresholds.c_str());
+      return 2;
+    }
+    if (limits.empty())
+    {
+      std::fprintf(stderr, "no limits in %s, record them with --record\n", options.thresholds.c_str());
+      return 2;
+    }
+  }
+
+  elf_firmware_t firmware;
+  std::memset(&firmware, 0, sizeof(firmware));
+  if (elf_read_firmware(options.elf.c_str(), &firmware) != 0)
+  {
+    std::fprintf(stderr, "cannot read %s\n", options.elf.c_str());
+    return 2;
+  }
+  if (options.mcu.empty())
+  {
+    options.mcu = firmware.mmcu[0] ? firmware.mmcu : "atmega328p";
+  }
+  bool mega = options.mcu == "atmega2560" || options.mcu == "atmega1280";
+  int returnAddressSize = (options.mcu == "atmega2560") ? 3 : 2;
+  if (options.sampleVector < 0)
+  {
+    options.sampleVector = mega ? 20 : 13; // TIMER1_OVF_vect
+  }
+
+  avr_t *avr = avr_make_mcu_by_name(options.mcu.c_str());
+  if (avr == nullptr)
+  {
+    std::fprintf(stderr, "unknown MCU %s\n", options.mcu.c_str());
+    return 2;
+  }
+  avr_init(avr);
+  avr->frequency = kFrequency;
+  avr_load_firmware(avr, &firmware);
+
+  // MPU6050 on the TWI, with the emulator's default motor waveform
+  static const char *peerNames[2] = {"twi.mpu.in", "twi.mpu.out"};
+  MpuPeer peer;
+  peer.avr = avr;
+  peer.irq = avr_alloc_irq(&avr->irq_pool, 0, 2, peerNames);
+  hal::WaveformConfig waveform;
+  waveform.tones.push_back({0, 25.0, 0.5});
+  waveform.tones.push_back({1, 25.0, 0.3});
+  waveform.tones.push_back({2, 25.0, 0.2});
+  waveform.tones.push_back({0, 87.0, 0.1});
+  peer.model.configure(waveform, 1);
+  avr_irq_register_notify(peer.irq + TWI_IRQ_OUTPUT, twiMessage, &peer);
+  avr_connect_irq(peer.irq + TWI_IRQ_INPUT, avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_INPUT));
+  avr_connect_irq(avr_io_getirq(avr, AVR_IOCTL_TWI_GETIRQ(0), TWI_IRQ_OUTPUT), peer.irq + TWI_IRQ_OUTPUT);
+
+  // Capture the UART instead of printing it
+  Capture capture;
+  capture.avr = avr;
+  uint32_t flags = 0;
+  avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+  flags &= ~AVR_UART_FLAG_STDIO;
+  avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+  avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uartOutput, &capture);
+
+  // Every vector for the latency, the sampling vector for its duration
+  std::vector<VectorTiming> timings;
+  timings.reserve(avr->interrupts.vector_count);
+  for (int i = 0; i < avr->interrupts.vector_count; i++)
+  {
+    VectorTiming timing;
+    timing.vector = avr->interrupts.vector[i];
+    timing.avr = avr;
+    timings.push_back(timing);
+  }
+  VectorTiming *sampling = nullptr;
+  for (VectorTiming &timing : timings)
+  {
+    avr_irq_t *irq = avr_get_interrupt_irq(avr, timing.vector->vector);
+    avr_irq_register_notify(irq + AVR_INT_IRQ_PENDING, vectorPending, &timing);
+    avr_irq_register_notify(irq + AVR_INT_IRQ_RUNNING, vectorRunning, &timing);
+    if (timing.vector->vector == options.sampleVector)
+    {
+      sampling = &timing;
+    }
+  }
+
+  uint32_t sendBuffer = findSymbol(options.elf, "_Z10sendBufferv");
+  if (sendBuffer == 0)
+  {
+    std::fprintf(stderr, "warning: no sendBuffer() in the symbol table, block time not measured\n");
+  }
+
+  // Commands after boot, STATS once they have settled and again at the end
+  const avr_cycle_count_t second = kFrequency;
+  const avr_cycle_count_t commandAt = second / 5;
+  const avr_cycle_count_t measureAt = second / 2;
+  const avr_cycle_count_t statsAt = static_cast<avr_cycle_count_t>(options.seconds * second);
+  const avr_cycle_count_t endAt = statsAt + second * 6 / 10; // The reply may wait for a block to be sent
+  bool commandsSent = false, firstStats = false, lastStats = false;
+
+  uint64_t blocks = 0, blockCycles = 0, worstBlockCycles = 0;
+  avr_cycle_count_t blockStart = 0;
+  uint16_t blockStack = 0;
+  bool inBlock = false;
+
+  int state = cpu_Running;
+  while (avr->cycle < endAt && state != cpu_Done && state != cpu_Crashed)
+  {
+    state = avr_run(avr);
+
+    uint16_t stack = avr->data[R_SPL] | avr->data[R_SPH] << 8;
+    if (!inBlock && sendBuffer && avr->pc == sendBuffer)
+    {
+      inBlock = true;
+      blockStart = avr->cycle;
+      blockStack = stack;
+    }
+    else if (inBlock && stack >= blockStack + returnAddressSize)
+    {
+      // Returned: the return address has been popped
+      uint64_t cycles = avr->cycle - blockStart;
+      inBlock = false;
+      blocks++;
+      blockCycles += cycles;
+      if (cycles > worstBlockCycles)
+      {
+        worstBlockCycles = cycles;
+      }
+    }
+
+    if (!commandsSent && avr->cycle >= commandAt)
+    {
+      for (const std::string &command : options.commands)
+      {
+        sendLine(avr, command);
+      }
+      commandsSent = true;
+    }
+    if (!firstStats && avr->cycle >= measureAt)
+    {
+      sendLine(avr, "STATS");
+      firstStats = true;
+    }
+    if (!lastStats && avr->cycle >= statsAt)
+    {
+      sendLine(avr, "STATS");
+      lastStats = true;
+    }
+  }
+  if (state == cpu_Crashed)
+  {
+    std::fprintf(stderr, "the firmware crashed at pc 0x%04x\n", static_cast<unsigned>(avr->pc));
+    return 1;
+  }
+
+  // Results, in the units of the thresholds file
+  std::map<std::string, double> results;
+  uint64_t worstLatency = 0;
+  int worstVector = -1;
+  for (const VectorTiming &timing : timings)
+  {
+    if (timing.worstLatency > worstLatency)
+    {
+      worstLatency = timing.worstLatency;
+      worstVector = timing.vector->vector;
+    }
+  }
+  results["max_latency_cycles"] = double(worstLatency);
+  std::printf("interrupt latency    max %llu cycles (%.1f us, vector %d)\n", (unsigned long long)worstLatency,
+              worstLatency * 1e6 / kFrequency, worstVector);
+
+  if (sampling && sampling->calls)
+  {
+    results["max_isr_cycles"] = double(sampling->worstCycles);
+    std::printf("sampling interrupt   %llu calls, avg %.1f cycles, max %llu cycles\n",
+                (unsigned long long)sampling->calls, double(sampling->totalCycles) / sampling->calls,
+                (unsigned long long)sampling->worstCycles);
+  }
+  else
+  {
+    std::printf("sampling interrupt   vector %d never ran\n", options.sampleVector);
+  }
+
+  if (blocks)
+  {
+    results["max_block_ms"] = worstBlockCycles * 1e3 / kFrequency;
+    std::printf("sendBuffer()         %llu calls, avg %.1f ms, max %.1f ms\n", (unsigned long long)blocks,
+                blockCycles * 1e3 / kFrequency / blocks, worstBlockCycles * 1e3 / kFrequency);
+  }
+
+  if (capture.tags.size() >= 2)
+  {
+    // The blocks before the last were acquired between the first tag and the
+    // last, with the transmission of each block in between
+    const BlockTag &first = capture.tags.front();
+    const BlockTag &last = capture.tags.back();
+    double span = (last.start - first.start) / 1e6;
+    uint64_t samples = uint64_t(kBlockSamples) * (capture.tags.size() - 1);
+    uint32_t longestPeriod = 0;
+    double longestGap = 0, skipped = 0;
+    for (size_t i = 0; i + 1 < capture.tags.size(); i++)
+    {
+      const BlockTag &tag = capture.tags[i];
+      double lastSample = tag.start + (kBlockSamples - 1) * (tag.period / 1e3);
+      double gap = capture.tags[i + 1].start - lastSample; // us
+      if (gap > longestGap)
+      {
+        longestGap = gap;
+      }
+      if (tag.period > longestPeriod)
+      {
+        longestPeriod = tag.period;
+      }
+      if (tag.period && gap * 1e3 > tag.period)
+      {
+        skipped += gap * 1e3 / tag.period - 1;
+      }
+    }
+    if (span > 0)
+    {
+      results["min_rate_hz"] = samples / span;
+      std::printf("sample rate          %.2f Hz, %llu samples over %.2f s\n", samples / span,
+                  (unsigned long long)samples, span);
+    }
+    if (longestPeriod)
+    {
+      results["min_block_rate_hz"] = 1e9 / longestPeriod;
+      std::printf("within blocks        min %.2f Hz, longest period %u ns\n", 1e9 / longestPeriod, longestPeriod);
+    }
+    results["max_gap_ms"] = longestGap / 1e3;
+    std::printf("between blocks       max gap %.1f ms, about %.0f samples not taken\n", longestGap / 1e3, skipped);
+  }
+  else if (!capture.tags.empty())
+  {
+    std::printf("sample rate          one block, no span to measure over\n");
+  }
+  if (capture.stats.size() >= 2)
+  {
+    const auto &first = capture.stats.front();
+    const auto &last = capture.stats.back();
+    double elapsed = last.first - first.first;
+    uint32_t samples = last.second.at("samples") - first.second.at("samples");
+    uint32_t dropped = last.second.at("dropped") - first.second.at("dropped");
+    if (capture.tags.empty() && elapsed > 0)
+    {
+      results["min_rate_hz"] = samples / elapsed;
+      std::printf("sample rate          %.2f Hz over %.2f s\n", samples / elapsed, elapsed);
+    }
+    results["max_dropped"] = dropped;
+    std::printf("dropped samples      %u of %u\n", dropped, samples + dropped);
+  }
+  else
+  {
+    std::printf("dropped samples      no STATS reply\n");
+  }
+
+  int failures = 0;
+  for (const auto &limit : limits)
+  {
+    auto result = results.find(limit.first);
+    bool minimum = limit.first.compare(0, 4, "min_") == 0;
+    if (result == results.end())
+    {
+      std::printf("FAIL %s: not measured\n", limit.first.c_str());
+      failures++;
+    }
+    else if (minimum ? result->second < limit.second : result->second > limit.second)
+    {
+      std::printf("FAIL %s: %.2f, limit %.2f\n", limit.first.c_str(), result->second, limit.second);
+      failures++;
+    }
+  }
+  if (!limits.empty() && failures == 0)
+  {
+    std::printf("all %zu thresholds met\n", limits.size());
+  }
+
+  if (!options.record.empty())
+  {
+    if (!recordThresholds(options.record, results, options))
+    {
+      std::fprintf(stderr, "cannot write %s\n", options.record.c_str());
+      failures++;
+    }
+    else
+    {
+      std::printf("recorded %zu limits in %s\n", results.size(), options.record.c_str());
+    }
+  }
+
+  avr_terminate(avr);
+  return failures ? 1 : 0;
+}